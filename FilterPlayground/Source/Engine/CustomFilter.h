@@ -1,46 +1,38 @@
-/*
-  ==============================================================================
-
-    filter.h
-    Created: 30 Jul 2022 10:16:34pm
-    Author:  Natalia Escalera
-
-  ==============================================================================
-*/
-
-#pragma once
-#include <math.h>
-class CustomFilter
-{
- public:
-    float SampleRate;
-    
-
-    using CoefficientsPtr = typename juce::dsp::IIR::Coefficients<float>::Ptr;
-    CoefficientsPtr coefficients;
-    
-    inline juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> makeCoefficients(double sampleRate, float cFreq)
-    {
-        DBG("sampleRate:");
-        DBG(sampleRate);
-        DBG("cFreq:");
-        DBG(cFreq);
-
-        juce::ReferenceCountedArray<juce::dsp::IIR::Coefficients<float>> coefficients;
-
-        jassert (sampleRate > 0.0);
-        jassert (cFreq > 0 && cFreq <= static_cast<float> (sampleRate * 0.5));
-        
-        float wd = 2 * juce::MathConstants<float>::pi * cFreq;
-        float T = 1/sampleRate;
-        float wa = (2/T) * std::tan(wd*T/2);
-        float g = wa * T/2;
-        
-        float alpha = g /(1.0 + g);
-        coefficients.add(new juce::dsp::IIR::Coefficients<float> (alpha, alpha, alpha, alpha));
-        
-        return coefficients;
-    }
-private:
-    float R12;
-};
+/*
+  ==============================================================================
+
+    filter.h
+    Created: 30 Jul 2022 10:16:34pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <math.h>
+#include "SharedResources.h"
+
+class CustomFilter
+{
+ public:
+    float SampleRate;
+    
+    // Picks up the process-wide alpha table for this sample rate, call from prepareToPlay
+    void prepare(SharedDspResources& resources, double sampleRate)
+    {
+        SampleRate = static_cast<float> (sampleRate);
+        alphaTable = resources.getOnePoleAlphaTable(sampleRate);
+    }
+
+    float getAlpha(double sampleRate, float cFreq) const
+    {
+        if (alphaTable != nullptr && alphaTable->sampleRate == sampleRate)
+            return alphaTable->lookup(cFreq);
+
+        return designOnePoleAlpha(sampleRate, cFreq);
+    }
+
+private:
+    float R12;
+    std::shared_ptr<const OnePoleAlphaTable> alphaTable;
+};
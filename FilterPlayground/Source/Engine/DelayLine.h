@@ -0,0 +1,331 @@
+/*
+  ==============================================================================
+
+    DelayLine.h
+    Created: 16 Oct 2022 11:08:57am
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "DspArena.h"
+
+enum class DelayStructure
+{
+    FeedbackComb,       // y = x + g y[n-D]
+    FeedforwardComb,    // y = x + g x[n-D]
+    Allpass,            // Schroeder: v = x + g v[n-D], y = v[n-D] - g v
+    FractionalDelay     // y = x[n-D]
+};
+
+enum class DelayInterpolation
+{
+    None,       // D rounded to whole samples
+    Linear,
+    Lagrange,   // third order, four taps
+    Thiran      // first-order allpass, flat magnitude, keeps its own state
+};
+
+// One delay-line filter on one channel. The ring is a power of two (masked indexing, no
+// modulo or wrap branch) and starts on a cache line, and it's sized once in prepare() for the
+// longest delay it will be asked for, so nothing allocates once audio runs. Reads and writes
+// both walk the ring sequentially, so even a long delay at 192 kHz streams through the
+// cache instead of missing on every sample.
+//
+// The processor's delay stage takes its ring from the DspArena; graph modules, compiled away
+// from any one arena, hold theirs in the filter's own storage.
+//
+// The delay and gain are per block. The interpolator's coefficients are worked out once per
+// block and the structure/interpolation pair is picked with one switch per block, so the
+// per-sample loops have no branches.
+class DelayLineFilter
+{
+public:
+    // Shortest delay every interpolator can serve from past samples only (Lagrange reads one ahead)
+    static constexpr float minimumDelay = 2.f;
+
+    // Moving hands the storage (or the arena block) over with ring still pointing into it; a copy
+    // would point back into the original's buffer, so there isn't one
+    DelayLineFilter() = default;
+    DelayLineFilter(DelayLineFilter&&) noexcept = default;
+    DelayLineFilter& operator=(DelayLineFilter&&) noexcept = default;
+
+    static size_t getArenaBytes(float maximumDelaySamples) noexcept
+    {
+        return DspArena::bytesFor<float>((size_t) getRingSize(maximumDelaySamples));
+    }
+
+    // Not on the audio thread. The ring comes from the arena, see getArenaBytes().
+    void prepare(DspArena& arena, float maximumDelaySamples)
+    {
+        auto size = getRingSize(maximumDelaySamples);
+
+        std::vector<float>().swap(storage);
+        setRing(arena.take<float>((size_t) size), size);
+    }
+
+    // Not on the audio thread. The ring is held in the filter's own storage.
+    void prepare(float maximumDelaySamples)
+    {
+        auto size = getRingSize(maximumDelaySamples);
+
+        storage.assign((size_t) size + alignmentFloats, 0.f);
+
+        auto address = reinterpret_cast<std::uintptr_t> (storage.data());
+        setRing(storage.data() + ((cacheLineBytes - (address % cacheLineBytes)) % cacheLineBytes) / sizeof(float), size);
+    }
+
+    void reset() noexcept
+    {
+        if (ring != nullptr)
+            std::fill(ring, ring + mask + 1, 0.f);
+
+        writePosition = 0;
+        thiranState = 0;
+        thiranPrevious = 0;
+    }
+
+    // Heap the filter holds itself, the ring when it isn't in an arena
+    size_t getHeapBytes() const noexcept { return storage.capacity() * sizeof(float); }
+
+    void setParameters(DelayStructure newStructure, DelayInterpolation newInterpolation, float delaySamples, float newGain) noexcept
+    {
+        structure = newStructure;
+        interpolation = newInterpolation;
+        delay = juce::jlimit(minimumDelay, maximumDelay, delaySamples);
+        gain = newGain;
+    }
+
+    float getMaximumDelay() const noexcept { return maximumDelay; }
+
+    void process(const float* in, float* out, int numSamples) noexcept
+    {
+        switch (interpolation)
+        {
+            case DelayInterpolation::None:
+            {
+                Rounded rounded (delay);
+                processWith(rounded, in, out, numSamples);
+                break;
+            }
+            case DelayInterpolation::Linear:
+            {
+                Linear linear (delay);
+                processWith(linear, in, out, numSamples);
+                break;
+            }
+            case DelayInterpolation::Lagrange:
+            {
+                Lagrange lagrange (delay);
+                processWith(lagrange, in, out, numSamples);
+                break;
+            }
+            case DelayInterpolation::Thiran:
+            {
+                Thiran thiran (delay, thiranState, thiranPrevious);
+                processWith(thiran, in, out, numSamples);
+                thiranState = thiran.state;
+                thiranPrevious = thiran.previous;
+                break;
+            }
+        }
+    }
+
+    // Ring contents, write position and interpolator state, for DSP snapshots
+    size_t getStateSize() const noexcept { return (size_t) (mask + 1) * sizeof(float) + sizeof(int) + 2 * sizeof(float); }
+
+    void saveState(char* dest) const noexcept
+    {
+        std::memcpy(dest, ring, (size_t) (mask + 1) * sizeof(float));
+        dest += (size_t) (mask + 1) * sizeof(float);
+        std::memcpy(dest, &writePosition, sizeof(int));
+        std::memcpy(dest + sizeof(int), &thiranState, sizeof(float));
+        std::memcpy(dest + sizeof(int) + sizeof(float), &thiranPrevious, sizeof(float));
+    }
+
+    void loadState(const char* source) noexcept
+    {
+        std::memcpy(ring, source, (size_t) (mask + 1) * sizeof(float));
+        source += (size_t) (mask + 1) * sizeof(float);
+        std::memcpy(&writePosition, source, sizeof(int));
+        std::memcpy(&thiranState, source + sizeof(int), sizeof(float));
+        std::memcpy(&thiranPrevious, source + sizeof(int) + sizeof(float), sizeof(float));
+    }
+
+private:
+    static constexpr std::uintptr_t cacheLineBytes = DspArena::cacheLineBytes;
+    static constexpr size_t alignmentFloats = cacheLineBytes / sizeof(float);
+
+    static int getRingSize(float maximumDelaySamples) noexcept
+    {
+        return juce::nextPowerOfTwo(static_cast<int> (std::ceil(maximumDelaySamples)) + 4);
+    }
+
+    void setRing(float* newRing, int size) noexcept
+    {
+        ring = newRing;
+        mask = ring != nullptr ? size - 1 : 0;
+        maximumDelay = ring != nullptr ? static_cast<float> (size - 4) : minimumDelay;
+
+        reset();
+    }
+
+    // Interpolators read relative to the write position: once x[n] is written there,
+    // position - k holds x[n-k].
+    struct Rounded
+    {
+        explicit Rounded(float d) : offset(juce::roundToInt(d)) {}
+
+        float read(const float* ring, int mask, int position) noexcept { return ring[(position - offset) & mask]; }
+
+        int offset;
+    };
+
+    struct Linear
+    {
+        explicit Linear(float d)
+            : offset(static_cast<int> (d)),
+              fraction(d - static_cast<float> (offset))
+        {
+        }
+
+        float read(const float* ring, int mask, int position) noexcept
+        {
+            auto a = ring[(position - offset) & mask];
+            auto b = ring[(position - offset - 1) & mask];
+            return a + fraction * (b - a);
+        }
+
+        int offset;
+        float fraction;
+    };
+
+    // Taps x[n-i+1] .. x[n-i-2] around the delay, d = 1 + fraction from the first tap
+    struct Lagrange
+    {
+        explicit Lagrange(float delaySamples)
+            : offset(static_cast<int> (delaySamples) - 1)
+        {
+            auto d = delaySamples - static_cast<float> (offset);
+
+            h0 = -(d - 1.f) * (d - 2.f) * (d - 3.f) / 6.f;
+            h1 = d * (d - 2.f) * (d - 3.f) * 0.5f;
+            h2 = -d * (d - 1.f) * (d - 3.f) * 0.5f;
+            h3 = d * (d - 1.f) * (d - 2.f) / 6.f;
+        }
+
+        float read(const float* ring, int mask, int position) noexcept
+        {
+            auto base = position - offset;
+
+            return h0 * ring[base & mask]
+                 + h1 * ring[(base - 1) & mask]
+                 + h2 * ring[(base - 2) & mask]
+                 + h3 * ring[(base - 3) & mask];
+        }
+
+        int offset;
+        float h0, h1, h2, h3;
+    };
+
+    // First-order allpass: integer part M with the remainder kept in [0.5, 1.5) where the
+    // allpass is best behaved, y = a x[n-M] + x[n-M-1] - a y[n-1]
+    struct Thiran
+    {
+        Thiran(float delaySamples, float s, float p)
+            : offset(static_cast<int> (delaySamples - 0.5f)),
+              state(s),
+              previous(p)
+        {
+            auto remainder = delaySamples - static_cast<float> (offset);
+            a = (1.f - remainder) / (1.f + remainder);
+        }
+
+        float read(const float* ring, int mask, int position) noexcept
+        {
+            auto x = ring[(position - offset) & mask];
+            auto y = a * (x - state) + previous;
+            previous = x;
+            state = y;
+            return y;
+        }
+
+        int offset;
+        float a;
+        float state, previous;
+    };
+
+    template <typename Interpolator>
+    void processWith(Interpolator& interpolator, const float* in, float* out, int numSamples) noexcept
+    {
+        switch (structure)
+        {
+            case DelayStructure::FeedbackComb:    run<Interpolator, DelayStructure::FeedbackComb>(interpolator, in, out, numSamples); break;
+            case DelayStructure::FeedforwardComb: run<Interpolator, DelayStructure::FeedforwardComb>(interpolator, in, out, numSamples); break;
+            case DelayStructure::Allpass:         run<Interpolator, DelayStructure::Allpass>(interpolator, in, out, numSamples); break;
+            case DelayStructure::FractionalDelay: run<Interpolator, DelayStructure::FractionalDelay>(interpolator, in, out, numSamples); break;
+        }
+    }
+
+    template <typename Interpolator, DelayStructure Structure>
+    void run(Interpolator& interpolator, const float* in, float* out, int numSamples) noexcept
+    {
+        auto* line = ring;
+        auto position = writePosition;
+        const auto g = gain;
+
+        for( int i = 0; i < numSamples; ++i )
+        {
+            // Every tap is at least one sample back, so reading before writing x[n] is safe
+            auto delayed = interpolator.read(line, mask, position);
+            auto x = in[i];
+
+            if constexpr (Structure == DelayStructure::FeedbackComb)
+            {
+                auto y = x + g * delayed;
+                line[position] = y;
+                out[i] = y;
+            }
+            else if constexpr (Structure == DelayStructure::FeedforwardComb)
+            {
+                line[position] = x;
+                out[i] = x + g * delayed;
+            }
+            else if constexpr (Structure == DelayStructure::Allpass)
+            {
+                auto v = x + g * delayed;
+                line[position] = v;
+                out[i] = delayed - g * v;
+            }
+            else
+            {
+                line[position] = x;
+                out[i] = delayed;
+            }
+
+            position = (position + 1) & mask;
+        }
+
+        writePosition = position;
+    }
+
+    std::vector<float> storage;
+    float* ring {nullptr};
+    int mask {0};
+    int writePosition {0};
+    float maximumDelay {0};
+
+    DelayStructure structure {DelayStructure::FeedbackComb};
+    DelayInterpolation interpolation {DelayInterpolation::Linear};
+    float delay {minimumDelay};
+    float gain {0};
+
+    float thiranState {0}, thiranPrevious {0};
+
+    JUCE_DECLARE_NON_COPYABLE(DelayLineFilter)
+};
@@ -0,0 +1,94 @@
+/*
+  ==============================================================================
+
+    DspArena.h
+    Created: 18 Oct 2022 7:44:36pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// One contiguous block per processor instance for every buffer the DSP sizes in prepareToPlay.
+// A host cycling through hundreds of instances per block then walks one run of memory per
+// instance instead of a dozen small heap blocks scattered wherever the allocator put them.
+//
+// Usage is two steps on the message thread: sum the components' getArenaBytes() and allocate(),
+// then let each component take() its buffers in prepare(). Every take() starts on its own cache
+// line, so buffers never share a line with another component's (or another instance's) data.
+// Nothing is freed piecemeal, release() drops the lot.
+class DspArena
+{
+public:
+    static constexpr size_t cacheLineBytes = 64;
+
+    static constexpr size_t roundUp(size_t numBytes) noexcept
+    {
+        return (numBytes + cacheLineBytes - 1) & ~(cacheLineBytes - 1);
+    }
+
+    // What take<T>(count) will use, for getArenaBytes()
+    template <typename T>
+    static constexpr size_t bytesFor(size_t count) noexcept { return roundUp(count * sizeof(T)); }
+
+    // Message thread. Keeps the existing block if it's already the right size.
+    void allocate(size_t numBytes)
+    {
+        numBytes = roundUp(numBytes);
+
+        if (numBytes != capacity)
+        {
+            storage.free();
+            storage.allocate(numBytes + cacheLineBytes, false);
+            capacity = numBytes;
+
+            auto address = reinterpret_cast<std::uintptr_t> (storage.getData());
+            base = storage.getData() + (cacheLineBytes - address % cacheLineBytes) % cacheLineBytes;
+        }
+
+        used = 0;
+        std::memset(base, 0, capacity);
+    }
+
+    void release()
+    {
+        storage.free();
+        base = nullptr;
+        capacity = used = 0;
+    }
+
+    // Message thread, in prepare(). Zeroed and cache-line aligned, valid until the next
+    // allocate() or release().
+    template <typename T>
+    T* take(size_t count) noexcept
+    {
+        static_assert (std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+                       "the arena never runs constructors or destructors");
+
+        auto numBytes = bytesFor<T>(count);
+
+        // A getArenaBytes() that doesn't match its prepare()
+        jassert (used + numBytes <= capacity);
+
+        if (used + numBytes > capacity)
+            return nullptr;
+
+        auto* block = base + used;
+        used += numBytes;
+        return reinterpret_cast<T*> (block);
+    }
+
+    size_t getCapacity() const noexcept { return capacity; }
+    size_t getBytesUsed() const noexcept { return used; }
+
+private:
+    juce::HeapBlock<char> storage;
+    char* base {nullptr};
+    size_t capacity {0};
+    size_t used {0};
+};
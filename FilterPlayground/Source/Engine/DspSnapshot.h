@@ -0,0 +1,97 @@
+/*
+  ==============================================================================
+
+    DspSnapshot.h
+    Created: 15 Oct 2022 6:52:03pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <cstring>
+#include <type_traits>
+#include "Modulation.h"
+#include "OnePoleTPT.h"
+#include "LadderFilter.h"
+
+// Fixed part of a DSP state snapshot. The delay stage's lines (delayStateSize bytes), the STFT
+// frames (spectralStateSize bytes, sized for the running layout and none without one) and the
+// processing graph's memories (graphStateSize bytes) follow it in the same blob, so the whole thing is one flat copyable block of memory: no
+// pointers, no allocation, safe to memcpy, stash in a host's pre-render cache or write to disk
+// next to an offline render. Only meaningful for the same plugin version, sample rate, STFT layout and graph.
+struct DspSnapshotHeader
+{
+    static constexpr juce::uint32 magicNumber = 0x46505353;   // "FPSS"
+    static constexpr juce::uint32 currentVersion = 6;
+
+    juce::uint32 magic;
+    juce::uint32 version;
+    double sampleRate;
+
+    juce::int32 filterMode;         // FilterMode the blocks before the capture ran in
+
+    OnePoleState lowPass[2];
+    bool lowPassModulated;
+    LadderState ladder[2];
+
+    float envelopeFollower;
+    ModulationEngine::State modulation;
+
+    bool delayActive;
+    juce::uint32 delayStateSize;
+
+    juce::int32 spectralLayout;     // SpectralLayoutSettings::pack(), 0 when there was none
+    juce::uint32 spectralStateSize;
+
+    juce::int32 graphNodes;         // -1 when there was no graph
+    juce::uint32 graphStateSize;
+};
+
+static_assert (std::is_trivially_copyable<DspSnapshotHeader>::value, "snapshots are copied as raw bytes");
+
+// Bounds-checked cursor over a snapshot blob
+struct DspSnapshotWriter
+{
+    char* data;
+    size_t capacity;
+    size_t position {0};
+
+    bool write(const void* source, size_t size) noexcept
+    {
+        if (position + size > capacity)
+            return false;
+
+        std::memcpy(data + position, source, size);
+        position += size;
+        return true;
+    }
+};
+
+struct DspSnapshotReader
+{
+    const char* data;
+    size_t size;
+    size_t position {0};
+
+    bool read(void* dest, size_t numBytes) noexcept
+    {
+        if (position + numBytes > size)
+            return false;
+
+        std::memcpy(dest, data + position, numBytes);
+        position += numBytes;
+        return true;
+    }
+
+    const char* skip(size_t numBytes) noexcept
+    {
+        if (position + numBytes > size)
+            return nullptr;
+
+        auto* start = data + position;
+        position += numBytes;
+        return start;
+    }
+};
@@ -0,0 +1,114 @@
+/*
+  ==============================================================================
+
+    EnvelopeFollower.h
+    Created: 4 Sep 2022 11:48:03am
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+// Sum of squares with four independent accumulators so the compiler can keep it in SIMD registers
+inline float sumOfSquares(const float* samples, int numSamples) noexcept
+{
+    float acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    int i = 0;
+
+    for( ; i + 4 <= numSamples; i += 4 )
+    {
+        acc0 += samples[i]     * samples[i];
+        acc1 += samples[i + 1] * samples[i + 1];
+        acc2 += samples[i + 2] * samples[i + 2];
+        acc3 += samples[i + 3] * samples[i + 3];
+    }
+
+    for( ; i < numSamples; ++i )
+        acc0 += samples[i] * samples[i];
+
+    return (acc0 + acc1) + (acc2 + acc3);
+}
+
+// Peak/RMS follower that runs at control rate: each step detects a whole run of samples
+// with vector min/max or sum-of-squares, then applies one attack/release smoothing step.
+// Cheap enough to run every 32 samples and reads the host's buffers directly.
+class EnvelopeFollower
+{
+public:
+    enum class Mode
+    {
+        Peak,
+        Rms
+    };
+
+    void prepare(double newSampleRate, int newControlInterval)
+    {
+        sampleRate = newSampleRate;
+        controlInterval = newControlInterval;
+        reset();
+        setParameters(mode, attackMs, releaseMs);
+    }
+
+    void reset() noexcept
+    {
+        state = 0;
+    }
+
+    void setParameters(Mode newMode, float newAttackMs, float newReleaseMs) noexcept
+    {
+        mode = newMode;
+        attackMs = newAttackMs;
+        releaseMs = newReleaseMs;
+
+        attackCoef = timeToCoefficient(attackMs);
+        releaseCoef = timeToCoefficient(releaseMs);
+    }
+
+    // Returns the envelope (linear amplitude) after consuming numSamples from every channel
+    float processControlStep(const float* const* channels, int numChannels, int startSample, int numSamples) noexcept
+    {
+        float detected = 0;
+
+        if (mode == Mode::Peak)
+        {
+            for( int ch = 0; ch < numChannels; ++ch )
+            {
+                auto range = juce::FloatVectorOperations::findMinAndMax(channels[ch] + startSample, numSamples);
+                detected = juce::jmax(detected, -range.getStart(), range.getEnd());
+            }
+        }
+        else
+        {
+            for( int ch = 0; ch < numChannels; ++ch )
+                detected += sumOfSquares(channels[ch] + startSample, numSamples);
+
+            // RMS is smoothed in the power domain and square-rooted on the way out
+            detected /= static_cast<float> (juce::jmax(1, numChannels * numSamples));
+        }
+
+        auto coef = detected > state ? attackCoef : releaseCoef;
+        state = detected + coef * (state - detected);
+
+        return mode == Mode::Peak ? state : std::sqrt(state);
+    }
+
+    float getState() const noexcept { return state; }
+    void setState(float newState) noexcept { state = newState; }
+
+private:
+    float timeToCoefficient(float timeMs) const noexcept
+    {
+        auto samples = static_cast<float> (sampleRate) * timeMs * 0.001f;
+        return samples > 0 ? std::exp(-static_cast<float> (controlInterval) / samples) : 0.f;
+    }
+
+    double sampleRate {44100};
+    int controlInterval {32};
+
+    Mode mode {Mode::Peak};
+    float attackMs {5.f}, releaseMs {150.f};
+    float attackCoef {0}, releaseCoef {0};
+    float state {0};
+};
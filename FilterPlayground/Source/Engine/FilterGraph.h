@@ -0,0 +1,672 @@
+/*
+  ==============================================================================
+
+    FilterGraph.h
+    Created: 28 Aug 2022 3:12:40pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "DelayLine.h"
+#include "DspArena.h"
+#include "Trace.h"
+
+enum class FilterModuleType
+{
+    LowPass,
+    HighPass,
+    BandPass,
+    LowShelf,
+    HighShelf,
+    Comb,               // feedback comb
+    FeedforwardComb,
+    Allpass,            // Schroeder allpass
+    FractionalDelay
+};
+
+// What the user builds: modules plus connections, edited freely on the message thread.
+// Nodes with no incoming connection read the graph input, nodes with no outgoing
+// connection are summed into the graph output, so a plain list of unconnected nodes
+// is a parallel bank and a line of connections is a serial chain.
+struct FilterGraphDescription
+{
+    struct Node
+    {
+        FilterModuleType type {FilterModuleType::LowPass};
+        float frequency {1000.f};
+        float resonance {0.707f};   // Q for the SVF modules
+        float gainDb {0.f};         // shelves only
+        float feedback {0.5f};      // comb/allpass gain
+
+        // Delay modules delay by sampleRate / frequency samples, i.e. a comb's first peak
+        // sits on the frequency. None rounds to whole samples.
+        DelayInterpolation interpolation {DelayInterpolation::None};
+    };
+
+    struct Connection
+    {
+        int source;
+        int destination;
+    };
+
+    int addNode(const Node& node)
+    {
+        nodes.push_back(node);
+        return static_cast<int> (nodes.size()) - 1;
+    }
+
+    void connect(int source, int destination)
+    {
+        jassert (source >= 0 && source < static_cast<int> (nodes.size()));
+        jassert (destination >= 0 && destination < static_cast<int> (nodes.size()));
+        connections.push_back({ source, destination });
+    }
+
+    // For the plugin state, next to the parameters
+    juce::ValueTree toValueTree() const
+    {
+        juce::ValueTree tree ("Graph");
+
+        for( auto& node : nodes )
+            tree.appendChild(juce::ValueTree ("Node", { { "type", static_cast<int> (node.type) },
+                                                        { "frequency", node.frequency },
+                                                        { "resonance", node.resonance },
+                                                        { "gainDb", node.gainDb },
+                                                        { "feedback", node.feedback },
+                                                        { "interpolation", static_cast<int> (node.interpolation) } }),
+                             nullptr);
+
+        for( auto& c : connections )
+            tree.appendChild(juce::ValueTree ("Connection", { { "source", c.source },
+                                                              { "destination", c.destination } }),
+                             nullptr);
+
+        return tree;
+    }
+
+    // Unknown module types and connections to missing nodes are dropped
+    static FilterGraphDescription fromValueTree(const juce::ValueTree& tree)
+    {
+        FilterGraphDescription description;
+        Node defaults;
+
+        for( const auto& child : tree )
+        {
+            if (! child.hasType("Node"))
+                continue;
+
+            int type = child.getProperty("type", -1);
+            if (type < 0 || type > static_cast<int> (FilterModuleType::FractionalDelay))
+                continue;
+
+            Node node;
+            node.type = static_cast<FilterModuleType> (type);
+            node.frequency = child.getProperty("frequency", defaults.frequency);
+            node.resonance = child.getProperty("resonance", defaults.resonance);
+            node.gainDb = child.getProperty("gainDb", defaults.gainDb);
+            node.feedback = child.getProperty("feedback", defaults.feedback);
+            node.interpolation = static_cast<DelayInterpolation> (juce::jlimit(0, static_cast<int> (DelayInterpolation::Thiran),
+                                                                               static_cast<int> (child.getProperty("interpolation", 0))));
+            description.addNode(node);
+        }
+
+        auto numNodes = static_cast<int> (description.nodes.size());
+
+        for( const auto& child : tree )
+        {
+            if (! child.hasType("Connection"))
+                continue;
+
+            int source = child.getProperty("source", -1);
+            int destination = child.getProperty("destination", -1);
+
+            if (juce::isPositiveAndBelow(source, numNodes) && juce::isPositiveAndBelow(destination, numNodes))
+                description.connect(source, destination);
+        }
+
+        return description;
+    }
+
+    std::vector<Node> nodes;
+    std::vector<Connection> connections;
+};
+
+// A graph ready to run: nodes in topological order, flat input lists, every buffer and every
+// bit of filter state allocated up front. Built on a non-audio thread by compile(), after that
+// process() never allocates and only switches on the module kernel once per node per block.
+class CompiledFilterGraph
+{
+public:
+    static std::unique_ptr<CompiledFilterGraph> compile(const FilterGraphDescription& description,
+                                                        double sampleRate,
+                                                        int maximumBlockSize,
+                                                        int numChannels)
+    {
+        auto numNodes = static_cast<int> (description.nodes.size());
+
+        // Kahn's algorithm, cycles leave nodes behind and are rejected
+        std::vector<int> inDegree((size_t) numNodes, 0);
+        std::vector<bool> hasOutput((size_t) numNodes, false);
+
+        for( auto& c : description.connections )
+        {
+            ++inDegree[(size_t) c.destination];
+            hasOutput[(size_t) c.source] = true;
+        }
+
+        std::vector<int> order;
+        for( int i = 0; i < numNodes; ++i )
+            if (inDegree[(size_t) i] == 0)
+                order.push_back(i);
+
+        for( size_t head = 0; head < order.size(); ++head )
+            for( auto& c : description.connections )
+                if (c.source == order[head] && --inDegree[(size_t) c.destination] == 0)
+                    order.push_back(c.destination);
+
+        if (static_cast<int> (order.size()) != numNodes)
+        {
+            jassertfalse; // the graph has a cycle
+            return nullptr;
+        }
+
+        std::unique_ptr<CompiledFilterGraph> graph (new CompiledFilterGraph());
+        graph->numChannels = numChannels;
+        graph->maximumBlockSize = maximumBlockSize;
+
+        // Node buffers are indexed by position in the schedule
+        std::vector<int> slotForNode((size_t) numNodes);
+        for( int slot = 0; slot < numNodes; ++slot )
+            slotForNode[(size_t) order[(size_t) slot]] = slot;
+
+        for( auto nodeIndex : order )
+        {
+            auto& source = description.nodes[(size_t) nodeIndex];
+
+            Node node {};
+            node.kernel = isDelayModule(source.type) ? Kernel::Delay : Kernel::Svf;
+            node.isSink = ! hasOutput[(size_t) nodeIndex];
+            node.firstInput = static_cast<int> (graph->inputs.size());
+
+            for( auto& c : description.connections )
+                if (c.destination == nodeIndex)
+                    graph->inputs.push_back(slotForNode[(size_t) c.source]);
+
+            node.numInputs = static_cast<int> (graph->inputs.size()) - node.firstInput;
+
+            if (node.kernel == Kernel::Svf)
+                node.svf = designSvf(source, sampleRate);
+            else
+                node.delay = designDelay(source, sampleRate);
+
+            graph->nodes.push_back(node);
+        }
+
+        graph->nodeBuffers.setSize(juce::jmax(1, numNodes), maximumBlockSize);
+        graph->svfStates.resize((size_t) (numNodes * numChannels));
+        graph->delayFilters.resize((size_t) (numNodes * numChannels));
+
+        for( int slot = 0; slot < numNodes; ++slot )
+        {
+            auto& node = graph->nodes[(size_t) slot];
+
+            if (node.kernel != Kernel::Delay)
+                continue;
+
+            for( int ch = 0; ch < numChannels; ++ch )
+            {
+                auto& filter = graph->delayFilters[(size_t) (slot * numChannels + ch)];
+                filter.prepare(node.delay.delaySamples);
+                filter.setParameters(node.delay.structure, node.delay.interpolation, node.delay.delaySamples, node.delay.gain);
+            }
+        }
+
+        return graph;
+    }
+
+    int getNumNodes() const noexcept { return static_cast<int> (nodes.size()); }
+
+    // Processes the block in place. Channels beyond the ones compiled for are left untouched.
+    void process(juce::dsp::AudioBlock<float>& block) noexcept
+    {
+        auto channels = juce::jmin(numChannels, static_cast<int> (block.getNumChannels()));
+        auto totalSamples = static_cast<int> (block.getNumSamples());
+
+        for( int start = 0; start < totalSamples; start += maximumBlockSize )
+        {
+            auto numSamples = juce::jmin(maximumBlockSize, totalSamples - start);
+
+            for( int ch = 0; ch < channels; ++ch )
+                processChannel(block.getChannelPointer((size_t) ch) + start, ch, numSamples);
+        }
+    }
+
+    void reset() noexcept
+    {
+        std::fill(svfStates.begin(), svfStates.end(), SvfState());
+
+        forEachDelayFilter([](DelayLineFilter& filter) { filter.reset(); });
+    }
+
+    // Filter memories as raw bytes: SVF integrators, then each delay module's ring and state.
+    // Two graphs compiled from the same description at the same rate share the layout.
+    size_t getStateSize() const noexcept
+    {
+        auto size = svfStates.size() * sizeof(SvfState);
+        forEachDelayFilter([&size](const DelayLineFilter& filter) { size += filter.getStateSize(); });
+        return size;
+    }
+
+    // Heap the compiled graph holds: the schedule, node buffers, filter states and delay rings
+    size_t getMemoryBytes() const noexcept
+    {
+        auto size = sizeof(*this)
+                  + nodes.capacity() * sizeof(Node)
+                  + inputs.capacity() * sizeof(int)
+                  + (size_t) nodeBuffers.getNumChannels() * (size_t) nodeBuffers.getNumSamples() * sizeof(float)
+                  + svfStates.capacity() * sizeof(SvfState)
+                  + delayFilters.capacity() * sizeof(DelayLineFilter);
+
+        forEachDelayFilter([&size](const DelayLineFilter& filter) { size += filter.getHeapBytes(); });
+        return size;
+    }
+
+    void saveState(char* dest) const noexcept
+    {
+        std::memcpy(dest, svfStates.data(), svfStates.size() * sizeof(SvfState));
+        dest += svfStates.size() * sizeof(SvfState);
+
+        forEachDelayFilter([&dest](const DelayLineFilter& filter)
+        {
+            filter.saveState(dest);
+            dest += filter.getStateSize();
+        });
+    }
+
+    void loadState(const char* source) noexcept
+    {
+        std::memcpy(svfStates.data(), source, svfStates.size() * sizeof(SvfState));
+        source += svfStates.size() * sizeof(SvfState);
+
+        forEachDelayFilter([&source](DelayLineFilter& filter)
+        {
+            filter.loadState(source);
+            source += filter.getStateSize();
+        });
+    }
+
+private:
+    CompiledFilterGraph() = default;
+
+    enum class Kernel
+    {
+        Svf,
+        Delay
+    };
+
+    static bool isDelayModule(FilterModuleType type) noexcept
+    {
+        return type == FilterModuleType::Comb
+            || type == FilterModuleType::FeedforwardComb
+            || type == FilterModuleType::Allpass
+            || type == FilterModuleType::FractionalDelay;
+    }
+
+    // TPT state-variable filter (Simper). Every SVF module type is the same kernel with
+    // different output mix, out = m0 * input + m1 * band + m2 * low.
+    struct SvfCoefficients
+    {
+        float a1, a2, a3;
+        float m0, m1, m2;
+    };
+
+    struct SvfState
+    {
+        float ic1 {0}, ic2 {0};
+    };
+
+    struct DelayCoefficients
+    {
+        DelayStructure structure;
+        DelayInterpolation interpolation;
+        float delaySamples;
+        float gain;
+    };
+
+    struct Node
+    {
+        Kernel kernel;
+        bool isSink;
+        int firstInput;
+        int numInputs;
+        SvfCoefficients svf;
+        DelayCoefficients delay;
+    };
+
+    static SvfCoefficients designSvf(const FilterGraphDescription::Node& source, double sampleRate)
+    {
+        auto frequency = juce::jlimit(10.f, static_cast<float> (sampleRate * 0.49), source.frequency);
+        auto g = std::tan(juce::MathConstants<float>::pi * frequency / static_cast<float> (sampleRate));
+        auto k = 1.f / juce::jmax(0.05f, source.resonance);
+        auto A = std::pow(10.f, source.gainDb / 40.f);
+
+        float m0 = 0, m1 = 0, m2 = 0;
+
+        switch (source.type)
+        {
+            case FilterModuleType::LowPass:   m2 = 1.f; break;
+            case FilterModuleType::HighPass:  m0 = 1.f; m1 = -k; m2 = -1.f; break;
+            case FilterModuleType::BandPass:  m1 = 1.f; break;
+            case FilterModuleType::LowShelf:  g /= std::sqrt(A); m0 = 1.f; m1 = k * (A - 1.f); m2 = A * A - 1.f; break;
+            case FilterModuleType::HighShelf: g *= std::sqrt(A); m0 = A * A; m1 = k * (1.f - A) * A; m2 = 1.f - A * A; break;
+            case FilterModuleType::Comb:
+            case FilterModuleType::FeedforwardComb:
+            case FilterModuleType::Allpass:
+            case FilterModuleType::FractionalDelay: jassertfalse; break;
+        }
+
+        SvfCoefficients c;
+        c.a1 = 1.f / (1.f + g * (g + k));
+        c.a2 = g * c.a1;
+        c.a3 = g * c.a2;
+        c.m0 = m0;
+        c.m1 = m1;
+        c.m2 = m2;
+        return c;
+    }
+
+    static DelayCoefficients designDelay(const FilterGraphDescription::Node& source, double sampleRate)
+    {
+        auto frequency = juce::jlimit(10.f, static_cast<float> (sampleRate * 0.49), source.frequency);
+
+        DelayCoefficients c;
+        c.structure = source.type == FilterModuleType::FeedforwardComb ? DelayStructure::FeedforwardComb
+                    : source.type == FilterModuleType::Allpass         ? DelayStructure::Allpass
+                    : source.type == FilterModuleType::FractionalDelay ? DelayStructure::FractionalDelay
+                                                                       : DelayStructure::FeedbackComb;
+        c.interpolation = source.interpolation;
+        c.delaySamples = juce::jmax(DelayLineFilter::minimumDelay, static_cast<float> (sampleRate) / frequency);
+        c.gain = juce::jlimit(-0.99f, 0.99f, source.feedback);
+        return c;
+    }
+
+    template <typename Graph, typename Function>
+    static void forEachDelayFilter(Graph& graph, Function&& function)
+    {
+        for( size_t slot = 0; slot < graph.nodes.size(); ++slot )
+            if (graph.nodes[slot].kernel == Kernel::Delay)
+                for( int ch = 0; ch < graph.numChannels; ++ch )
+                    function(graph.delayFilters[slot * (size_t) graph.numChannels + (size_t) ch]);
+    }
+
+    template <typename Function> void forEachDelayFilter(Function&& f)       { forEachDelayFilter(*this, f); }
+    template <typename Function> void forEachDelayFilter(Function&& f) const { forEachDelayFilter(*this, f); }
+
+    void processChannel(float* io, int channel, int numSamples) noexcept
+    {
+        auto numNodes = static_cast<int> (nodes.size());
+        bool outputWritten = false;
+
+        for( int slot = 0; slot < numNodes; ++slot )
+        {
+            auto& node = nodes[(size_t) slot];
+            auto* out = nodeBuffers.getWritePointer(slot);
+            const float* in = io;
+
+            if (node.numInputs == 1)
+            {
+                in = nodeBuffers.getReadPointer(inputs[(size_t) node.firstInput]);
+            }
+            else if (node.numInputs > 1)
+            {
+                juce::FloatVectorOperations::copy(out, nodeBuffers.getReadPointer(inputs[(size_t) node.firstInput]), numSamples);
+
+                for( int i = 1; i < node.numInputs; ++i )
+                    juce::FloatVectorOperations::add(out, nodeBuffers.getReadPointer(inputs[(size_t) (node.firstInput + i)]), numSamples);
+
+                in = out;
+            }
+
+            auto stateIndex = (size_t) (slot * numChannels + channel);
+
+            switch (node.kernel)
+            {
+                case Kernel::Svf:  processSvf(node.svf, svfStates[stateIndex], in, out, numSamples); break;
+                case Kernel::Delay: delayFilters[stateIndex].process(in, out, numSamples); break;
+            }
+        }
+
+        // Sinks are summed into the output only once every node has read the input
+        for( int slot = 0; slot < numNodes; ++slot )
+        {
+            if (! nodes[(size_t) slot].isSink)
+                continue;
+
+            if (outputWritten)
+                juce::FloatVectorOperations::add(io, nodeBuffers.getReadPointer(slot), numSamples);
+            else
+                juce::FloatVectorOperations::copy(io, nodeBuffers.getReadPointer(slot), numSamples);
+
+            outputWritten = true;
+        }
+    }
+
+    static void processSvf(const SvfCoefficients& c, SvfState& state, const float* in, float* out, int numSamples) noexcept
+    {
+        auto ic1 = state.ic1;
+        auto ic2 = state.ic2;
+
+        for( int i = 0; i < numSamples; ++i )
+        {
+            auto v0 = in[i];
+            auto v3 = v0 - ic2;
+            auto v1 = c.a1 * ic1 + c.a2 * v3;
+            auto v2 = ic2 + c.a2 * ic1 + c.a3 * v3;
+            ic1 = 2.f * v1 - ic1;
+            ic2 = 2.f * v2 - ic2;
+
+            out[i] = c.m0 * v0 + c.m1 * v1 + c.m2 * v2;
+        }
+
+        state.ic1 = ic1;
+        state.ic2 = ic2;
+    }
+
+    int numChannels {0};
+    int maximumBlockSize {0};
+
+    std::vector<Node> nodes;
+    std::vector<int> inputs;
+    juce::AudioBuffer<float> nodeBuffers;
+    std::vector<SvfState> svfStates;
+    std::vector<DelayLineFilter> delayFilters;
+
+    JUCE_DECLARE_NON_COPYABLE(CompiledFilterGraph)
+};
+
+// Owns the graph the audio thread is running and swaps in new ones without locks.
+// setGraph() hands a compiled graph over through an atomic pointer, the audio thread adopts it
+// at the start of a block and crossfades from the old graph's output to the new one. The old
+// graph comes back through another atomic slot and is deleted on the next setGraph() call,
+// so nothing is ever freed on the audio thread.
+class FilterGraphPlayer
+{
+public:
+    FilterGraphPlayer() = default;
+
+    ~FilterGraphPlayer()
+    {
+        abandonCrossfade();
+        delete pending.exchange(nullptr);
+        delete retired.exchange(nullptr);
+    }
+
+    static size_t getArenaBytes(int maximumBlockSize, int numChannels) noexcept
+    {
+        return (size_t) juce::jmin(numChannels, maxFadeChannels) * DspArena::bytesFor<float>((size_t) maximumBlockSize);
+    }
+
+    // Message thread, with the audio thread stopped (prepareToPlay)
+    void prepare(DspArena& arena, int maximumBlockSize, int numChannels, int crossfadeSamples)
+    {
+        crossfadeLength = juce::jmax(1, crossfadeSamples);
+        fadeChannels = juce::jmin(numChannels, maxFadeChannels);
+        fadeSamples = maximumBlockSize;
+
+        for( int ch = 0; ch < fadeChannels; ++ch )
+            fadeBuffer[(size_t) ch] = arena.take<float>((size_t) maximumBlockSize);
+
+        abandonCrossfade();
+    }
+
+    // Message thread, with the audio thread stopped: installs a graph without fading
+    void resetGraph(std::unique_ptr<CompiledFilterGraph> graph)
+    {
+        delete pending.exchange(nullptr);
+        delete retired.exchange(nullptr);
+        abandonCrossfade();
+        active = std::move(graph);
+        activeStateSize = active != nullptr ? active->getStateSize() : 0;
+        pendingStateSize = 0;
+        activeMemoryBytes = active != nullptr ? active->getMemoryBytes() : 0;
+        pendingMemoryBytes = 0;
+    }
+
+    // Message thread. Null means an empty graph, i.e. the stage passes audio through.
+    void setGraph(std::unique_ptr<CompiledFilterGraph> graph)
+    {
+        collectGarbage();
+
+        pendingStateSize = graph != nullptr ? graph->getStateSize() : 0;
+        pendingMemoryBytes = graph != nullptr ? graph->getMemoryBytes() : 0;
+        auto* wrapped = new Slot { std::move(graph) };
+        delete pending.exchange(wrapped);
+    }
+
+    void collectGarbage()
+    {
+        delete retired.exchange(nullptr);
+    }
+
+    // Audio thread. The graph whose output is (or is fading towards) the stage output.
+    CompiledFilterGraph* getActiveGraph() const noexcept { return active.get(); }
+
+    // Any thread. Snapshot bytes of the running graph or of one set but not adopted yet,
+    // whichever is larger, so a buffer sized from it fits whichever runs by capture time.
+    size_t getStateSize() const noexcept { return juce::jmax(activeStateSize.load(), pendingStateSize.load()); }
+
+    // Any thread. Heap held by the running graph and one set but not adopted yet.
+    size_t getMemoryBytes() const noexcept { return activeMemoryBytes.load() + pendingMemoryBytes.load(); }
+
+    void process(juce::dsp::AudioBlock<float>& block) noexcept
+    {
+        FP_TRACE_SCOPE("graph");
+
+        if (fadePosition >= crossfadeLength && retired.load() == nullptr)
+        {
+            if (auto* next = pending.exchange(nullptr))
+            {
+                fadingOut = std::move(active);
+                active = std::move(next->graph);
+                activeStateSize = active != nullptr ? active->getStateSize() : 0;
+                activeMemoryBytes = active != nullptr ? active->getMemoryBytes() : 0;
+                pendingMemoryBytes = 0;
+                fadePosition = 0;
+
+                // The slot itself goes back empty with the old graph, see finishCrossfade()
+                nextSlot = next;
+            }
+        }
+
+        if (fadePosition >= crossfadeLength)
+        {
+            if (active != nullptr)
+                active->process(block);
+
+            return;
+        }
+
+        auto numChannels = juce::jmin(static_cast<int> (block.getNumChannels()), fadeChannels);
+        auto numSamples = static_cast<int> (block.getNumSamples());
+        jassert (numSamples <= fadeSamples);
+
+        juce::dsp::AudioBlock<float> oldBlock (fadeBuffer.data(), (size_t) numChannels, (size_t) numSamples);
+        oldBlock.copyFrom(block.getSubsetChannelBlock(0, (size_t) numChannels));
+
+        if (fadingOut != nullptr)
+            fadingOut->process(oldBlock);
+
+        if (active != nullptr)
+            active->process(block);
+
+        auto step = 1.f / static_cast<float> (crossfadeLength);
+
+        for( int ch = 0; ch < numChannels; ++ch )
+        {
+            auto* newSamples = block.getChannelPointer((size_t) ch);
+            auto* oldSamples = oldBlock.getChannelPointer((size_t) ch);
+            auto gain = static_cast<float> (fadePosition) * step;
+
+            for( int i = 0; i < numSamples; ++i )
+            {
+                auto g = juce::jmin(1.f, gain);
+                newSamples[i] = oldSamples[i] + g * (newSamples[i] - oldSamples[i]);
+                gain += step;
+            }
+        }
+
+        fadePosition += numSamples;
+
+        if (fadePosition >= crossfadeLength)
+            finishCrossfade();
+    }
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<CompiledFilterGraph> graph;
+    };
+
+    void abandonCrossfade()
+    {
+        delete nextSlot;
+        nextSlot = nullptr;
+        fadingOut.reset();
+        fadePosition = crossfadeLength;
+    }
+
+    void finishCrossfade() noexcept
+    {
+        // Hand the old graph back in the slot it arrived in, freed later on the message thread
+        jassert (nextSlot != nullptr);
+        nextSlot->graph = std::move(fadingOut);
+        retired.store(nextSlot);
+        nextSlot = nullptr;
+    }
+
+    std::unique_ptr<CompiledFilterGraph> active, fadingOut;
+    Slot* nextSlot {nullptr};
+
+    std::atomic<Slot*> pending {nullptr};
+    std::atomic<Slot*> retired {nullptr};
+
+    std::atomic<size_t> activeStateSize {0}, pendingStateSize {0};
+    std::atomic<size_t> activeMemoryBytes {0}, pendingMemoryBytes {0};
+
+    // Old graph's output during a crossfade, in the processor's DspArena
+    static constexpr int maxFadeChannels = 2;
+    std::array<float*, maxFadeChannels> fadeBuffer {};
+    int fadeChannels {0}, fadeSamples {0};
+    int crossfadeLength {1};
+    int fadePosition {1};
+
+    JUCE_DECLARE_NON_COPYABLE(FilterGraphPlayer)
+};
@@ -0,0 +1,184 @@
+/*
+  ==============================================================================
+
+    FilterKernels.h
+    Created: 19 Oct 2022 6:12:50pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <vector>
+#include "OnePoleTPT.h"
+
+enum class KernelIsa
+{
+    Auto,       // best this CPU supports
+    Generic,    // whatever the build targets, the only option on platforms without variants
+    Sse2,
+    Avx2,
+    Avx512,
+    Neon
+};
+
+// The hot one-pole kernels for one instruction set. Builds target a baseline ISA, so the
+// OnePoleTPT kernels are compiled again inside functions that enable AVX2/FMA or AVX-512
+// (GCC/Clang target attributes, flatten pulls the baseline body in and recompiles it there)
+// and the best set the CPU supports is picked at run time. FMA contraction and wider vectors
+// change the rounding slightly, so variants agree to within float tolerance, not bit for bit.
+struct FilterKernels
+{
+    KernelIsa isa;
+    const char* name;
+
+    OnePoleProcessFn process;                           // one channel, closed-form four-sample steps
+    OnePoleRampFn processRamp;                          // one channel, per-sample alpha ramp
+    decltype(&OnePoleTPT::processStereo) processStereo; // across two channels
+};
+
+#if JUCE_INTEL && (JUCE_GCC || JUCE_CLANG)
+ #define FILTERPLAYGROUND_KERNEL_VARIANTS 1
+#else
+ #define FILTERPLAYGROUND_KERNEL_VARIANTS 0
+#endif
+
+namespace FilterKernelVariants
+{
+   #if FILTERPLAYGROUND_KERNEL_VARIANTS
+    __attribute__((target("avx2,fma"), flatten))
+    inline float processAvx2(float s, float alpha, const float* in, float* out, int numSamples) noexcept
+    {
+        return OnePoleTPT::process(s, alpha, in, out, numSamples);
+    }
+
+    __attribute__((target("avx2,fma"), flatten))
+    inline float processRampAvx2(float s, float alphaStart, float alphaEnd, const float* in, float* out, int numSamples) noexcept
+    {
+        return OnePoleTPT::processRamp(s, alphaStart, alphaEnd, in, out, numSamples);
+    }
+
+    __attribute__((target("avx2,fma"), flatten))
+    inline void processStereoAvx2(float& sL, float& sR, float alpha, float* left, float* right, int numSamples) noexcept
+    {
+        OnePoleTPT::processStereo(sL, sR, alpha, left, right, numSamples);
+    }
+
+    __attribute__((target("avx512f,avx512vl,avx2,fma"), flatten))
+    inline float processAvx512(float s, float alpha, const float* in, float* out, int numSamples) noexcept
+    {
+        return OnePoleTPT::process(s, alpha, in, out, numSamples);
+    }
+
+    __attribute__((target("avx512f,avx512vl,avx2,fma"), flatten))
+    inline float processRampAvx512(float s, float alphaStart, float alphaEnd, const float* in, float* out, int numSamples) noexcept
+    {
+        return OnePoleTPT::processRamp(s, alphaStart, alphaEnd, in, out, numSamples);
+    }
+
+    __attribute__((target("avx512f,avx512vl,avx2,fma"), flatten))
+    inline void processStereoAvx512(float& sL, float& sR, float alpha, float* left, float* right, int numSamples) noexcept
+    {
+        OnePoleTPT::processStereo(sL, sR, alpha, left, right, numSamples);
+    }
+   #endif
+}
+
+namespace FilterKernelDispatch
+{
+    // Every set compiled into this build, baseline first. SSE2 is the x86-64 baseline and NEON
+    // the arm64 one, so those two are the plain build of OnePoleTPT under another name.
+    inline const std::vector<FilterKernels>& getCompiledKernels()
+    {
+        static const std::vector<FilterKernels> kernels = []
+        {
+            std::vector<FilterKernels> k;
+
+           #if JUCE_INTEL && JUCE_64BIT
+            const auto baseline = KernelIsa::Sse2;
+            const auto* baselineName = "SSE2";
+           #elif JUCE_ARM && JUCE_64BIT
+            const auto baseline = KernelIsa::Neon;
+            const auto* baselineName = "NEON";
+           #else
+            const auto baseline = KernelIsa::Generic;
+            const auto* baselineName = "Generic";
+           #endif
+
+            k.push_back({ baseline, baselineName,
+                          OnePoleTPT::process, OnePoleTPT::processRamp, OnePoleTPT::processStereo });
+
+           #if FILTERPLAYGROUND_KERNEL_VARIANTS
+            using namespace FilterKernelVariants;
+            k.push_back({ KernelIsa::Avx2, "AVX2", processAvx2, processRampAvx2, processStereoAvx2 });
+            k.push_back({ KernelIsa::Avx512, "AVX-512", processAvx512, processRampAvx512, processStereoAvx512 });
+           #endif
+
+            return k;
+        }();
+
+        return kernels;
+    }
+
+    inline bool isSupported(KernelIsa isa)
+    {
+        switch (isa)
+        {
+            case KernelIsa::Avx2:   return juce::SystemStats::hasAVX2() && juce::SystemStats::hasFMA3();
+            case KernelIsa::Avx512: return juce::SystemStats::hasAVX512F() && juce::SystemStats::hasAVX512VL() && juce::SystemStats::hasFMA3();
+            case KernelIsa::Auto:
+            case KernelIsa::Generic:
+            case KernelIsa::Sse2:
+            case KernelIsa::Neon:   break;
+        }
+
+        return true;
+    }
+
+    // Compiled sets this CPU can run, baseline first
+    inline std::vector<const FilterKernels*> getAvailableKernels()
+    {
+        std::vector<const FilterKernels*> available;
+
+        for( auto& k : getCompiledKernels() )
+            if (isSupported(k.isa))
+                available.push_back(&k);
+
+        return available;
+    }
+
+    // Process-wide override for testing and benchmarking, Auto restores the CPUID choice.
+    // Also read once from the FILTERPLAYGROUND_KERNELS environment variable (sse2, avx2, ...).
+    inline std::atomic<KernelIsa>& getOverride()
+    {
+        static std::atomic<KernelIsa> isaOverride { []
+        {
+            auto name = juce::SystemStats::getEnvironmentVariable("FILTERPLAYGROUND_KERNELS", {}).toLowerCase();
+
+            for( auto& k : getCompiledKernels() )
+                if (name.isNotEmpty() && name == juce::String(k.name).toLowerCase().removeCharacters("-"))
+                    return k.isa;
+
+            return KernelIsa::Auto;
+        }() };
+
+        return isaOverride;
+    }
+
+    inline void setOverride(KernelIsa isa) { getOverride().store(isa); }
+
+    // The override if this CPU can run it, otherwise the widest set it can
+    inline const FilterKernels& select()
+    {
+        auto available = getAvailableKernels();
+        auto wanted = getOverride().load();
+
+        for( auto* k : available )
+            if (k->isa == wanted)
+                return *k;
+
+        return *available.back();
+    }
+}
@@ -0,0 +1,253 @@
+/*
+  ==============================================================================
+
+    LadderFilter.h
+    Created: 20 Oct 2022 9:17:42pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <cmath>
+
+enum class LadderAntialiasing
+{
+    None,
+    FirstOrder
+};
+
+// The ladder's saturator f(x) = x / sqrt(1 + x^2), its slope and its antiderivative, all closed
+// form. First-order antiderivative antialiasing swaps f(x[n]) for f averaged along the straight
+// line from x[n-1] to x[n], (F(x[n]) - F(x[n-1])) / (x[n] - x[n-1]). That's f behind a one-sample
+// box filter before it's sampled, so most of the harmonics that would fold back never get made.
+namespace LadderSaturator
+{
+    inline double f(double x) noexcept          { return x / std::sqrt(1.0 + x * x); }
+    inline double slope(double x) noexcept      { auto r = std::sqrt(1.0 + x * x); return 1.0 / (r * r * r); }
+
+    struct Value
+    {
+        double y;
+        double dy;  // d y / d x[n]
+    };
+
+    // F(x) = sqrt(1 + x^2), and (F(x) - F(x1)) / (x - x1) = (x + x1) / (r + r1): no cancellation
+    // and no special case when x1 is close to x. r1 is sqrt(1 + x1^2), worked out once per sample
+    // by the caller.
+    inline Value averaged(double x, double x1, double r1) noexcept
+    {
+        auto r = std::sqrt(1.0 + x * x);
+        auto d = r + r1;
+        return { (x + x1) / d, (d - (x + x1) * x / r) / (d * d) };
+    }
+}
+
+// Plain-old-data ladder state, for DSP snapshots
+struct LadderState
+{
+    double stages[4];       // the first stage's output, then the other three's TPT memories
+    double input;           // saturator input last sample
+    double saturated;       // and f of it, the plain trapezoid's other end
+    double average;         // last sample's averaged saturator output and slope, to seed the solve
+    double slope;
+};
+
+// Four-pole transistor-ladder style low-pass, one channel: four one-pole stages in series with
+// the saturator where the input and the inverted fourth stage meet,
+//   w = (1 + k) x - k y4,   stage one driven by f(w)
+// The (1 + k) input gain keeps unity gain at DC as resonance goes up.
+//
+// Every stage is a trapezoidal integrator, and stage one integrates the average of f(w) over
+// the step, (f(w[n]) + f(w[n-1])) / 2 for the plain trapezoid. The antialiased mode feeds it
+// the exact average along the segment from w[n-1] to w[n] instead (the first-order ADAA value).
+// Used that way antialiasing adds no delay to the loop, so the resonance doesn't shift and small
+// signals see exactly the linear ladder. (Applied to f(w[n]) itself, the half-sample delay of the
+// averaging is enough to make the loop ring and self-oscillate well below full resonance.)
+//
+// The loop has no unit delay (zero-delay feedback), so every sample solves
+//   w + 2 k G^4 A(w) = (1 + k) x - k (memories)
+// for w, A being the averaged saturator. Its slope is at least 1, so Newton from a linearised
+// first guess settles in two or three steps; the iteration count is capped so the per-sample
+// cost is bounded.
+//
+// Cutoff and resonance are set per block (or per control step when modulated). A change of
+// antialiasing (the quality tier moving) crossfades from the old mode's output to the new one's
+// over switchFadeSamples: the old mode runs on a copy of the state, which is then dropped.
+class LadderFilter
+{
+public:
+    static constexpr int maxIterations = 4;
+    static constexpr double maxFeedback = 4.0;  // where the linear ladder would self-oscillate
+    static constexpr int switchFadeSamples = 128;
+
+    void prepare(double newSampleRate) noexcept
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+
+    // Also finishes any fade, so an antialiasing set just before takes effect at once
+    void reset() noexcept
+    {
+        state = {};
+        fadeRemaining = 0;
+    }
+
+    void setAntialiasing(LadderAntialiasing newAntialiasing) noexcept
+    {
+        if (newAntialiasing == antialiasing)
+            return;
+
+        fadingFrom = antialiasing;
+        antialiasing = newAntialiasing;
+        fadeRemaining = switchFadeSamples;
+    }
+
+    // The plugin's Resonance parameter (0.1 to 10) as the amount setParameters() takes
+    static float getResonanceAmount(float parameterValue) noexcept
+    {
+        return juce::jlimit(0.f, 1.f, (parameterValue - 0.1f) / 9.9f);
+    }
+
+    // resonance is 0..1 of the way to self-oscillation
+    void setParameters(float cutoff, float resonance) noexcept
+    {
+        auto fc = juce::jlimit(20.0, 0.49 * sampleRate, static_cast<double> (cutoff));
+        auto g = std::tan(juce::MathConstants<double>::pi * fc / sampleRate);
+
+        G = g / (1.0 + g);
+        k = maxFeedback * juce::jlimit(0.0, 1.0, static_cast<double> (resonance));
+    }
+
+    void process(const float* in, float* out, int numSamples) noexcept
+    {
+        if (fadeRemaining > 0 && numSamples > 0)
+        {
+            auto n = juce::jmin(numSamples, fadeRemaining);
+            auto start = state;
+            std::array<float, switchFadeSamples> previous;
+
+            // Old mode first, so an in-place block's input is still there for the new one
+            runMode(fadingFrom, in, previous.data(), n);
+            state = start;
+            runMode(antialiasing, in, out, n);
+
+            auto step = 1.f / static_cast<float> (switchFadeSamples);
+            auto gain = static_cast<float> (switchFadeSamples - fadeRemaining) * step;
+
+            for( int i = 0; i < n; ++i )
+            {
+                gain += step;
+                out[i] = previous[(size_t) i] + gain * (out[i] - previous[(size_t) i]);
+            }
+
+            fadeRemaining -= n;
+            in += n;
+            out += n;
+            numSamples -= n;
+        }
+
+        runMode(antialiasing, in, out, numSamples);
+    }
+
+    LadderState& getState() noexcept { return state; }
+    const LadderState& getState() const noexcept { return state; }
+
+private:
+    void runMode(LadderAntialiasing mode, const float* in, float* out, int numSamples) noexcept
+    {
+        switch (mode)
+        {
+            case LadderAntialiasing::None:       run<LadderAntialiasing::None>(in, out, numSamples); break;
+            case LadderAntialiasing::FirstOrder: run<LadderAntialiasing::FirstOrder>(in, out, numSamples); break;
+        }
+    }
+
+    template <LadderAntialiasing Mode>
+    void run(const float* in, float* out, int numSamples) noexcept
+    {
+        const double oneMinusG = 1.0 - G;
+        const double decay = 1.0 - 2.0 * G;             // stage one, (1 - g) / (1 + g)
+        const double loopGain = 2.0 * k * G * G * G * G;
+
+        auto s = state;
+
+        // sqrt(1 + x1^2) for the averaged saturator, carried from one sample to the next
+        double r1 = Mode == LadderAntialiasing::FirstOrder ? std::sqrt(1.0 + s.input * s.input) : 0.0;
+
+        for( int i = 0; i < numSamples; ++i )
+        {
+            // What stage one's last output and the other memories contribute to y4
+            auto memories = G * G * G * decay * s.stages[0]
+                          + oneMinusG * ((G * s.stages[1] + s.stages[2]) * G + s.stages[3]);
+            auto target = (1.0 + k) * static_cast<double> (in[i]) - k * memories;
+
+            const double x1 = s.input;
+
+            // First guess: one Newton step from last sample's operating point
+            auto w = x1 + (target - x1 - loopGain * s.average) / (1.0 + loopGain * s.slope);
+            LadderSaturator::Value a {};
+
+            for( int iteration = 0;; ++iteration )
+            {
+                if constexpr (Mode == LadderAntialiasing::None)
+                    a = { 0.5 * (LadderSaturator::f(w) + s.saturated), 0.5 * LadderSaturator::slope(w) };
+                else
+                    a = LadderSaturator::averaged(w, x1, r1);
+
+                auto residual = w + loopGain * a.y - target;
+
+                if (std::abs(residual) < 1.0e-10 || iteration == maxIterations)
+                    break;
+
+                w -= residual / (1.0 + loopGain * a.dy);
+            }
+
+            s.input = w;
+            s.average = a.y;
+            s.slope = a.dy;
+
+            // f(w) is kept in both modes, so switching to the plain trapezoid (the governor
+            // dropping to Minimum mid-note) averages with this sample's value, not a stale one
+            if constexpr (Mode == LadderAntialiasing::None)
+            {
+                s.saturated = 2.0 * a.y - s.saturated;
+            }
+            else
+            {
+                auto r = std::sqrt(1.0 + w * w);
+                s.saturated = w / r;
+                r1 = r;
+            }
+
+            auto y = s.stages[0] = decay * s.stages[0] + 2.0 * G * a.y;
+
+            for( int stage = 1; stage < 4; ++stage )
+            {
+                auto v = (y - s.stages[stage]) * G;
+                y = v + s.stages[stage];
+                s.stages[stage] = y + v;
+            }
+
+            out[i] = static_cast<float> (y);
+        }
+
+        // Flush denormals out of the memories so a silent tail doesn't slow down
+        for( auto& stage : s.stages )
+            if (std::abs(stage) < 1.0e-15)
+                stage = 0;
+
+        state = s;
+    }
+
+    double sampleRate {44100};
+    double G {0.5}, k {0};
+    LadderAntialiasing antialiasing {LadderAntialiasing::FirstOrder};
+    LadderAntialiasing fadingFrom {LadderAntialiasing::FirstOrder};
+    int fadeRemaining {0};
+
+    LadderState state {};
+};
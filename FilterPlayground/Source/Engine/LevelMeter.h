@@ -0,0 +1,334 @@
+/*
+  ==============================================================================
+
+    LevelMeter.h
+    Created: 17 Oct 2022 8:31:14pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include "DspArena.h"
+#include "EnvelopeFollower.h"
+
+// Everything a meter shows, linear gains except the loudness
+struct LevelReadings
+{
+    std::array<float, 2> peak {};   // sample peak per channel, held and falling
+    std::array<float, 2> rms {};    // 300 ms window per channel
+    float truePeak {0};             // 4x oversampled, both channels, held and falling
+    float shortTermLufs {-100.f};   // BS.1770 K-weighted, 3 s window
+};
+
+// Sample peak, true peak, RMS and short-term loudness of whatever block it's given, measured on
+// the audio thread and published through relaxed atomics for the editor and headless tools.
+//
+// Kept cheap next to the filter: peaks are one vector min/max per channel, RMS and loudness are
+// sums of squares gathered into 100 ms bins and only turned into numbers when a bin completes,
+// true peak only interpolates around samples within 6 dB of the block's sample peak, and when
+// nobody has read the meter for a couple of seconds process() returns straight away.
+class LevelMeter
+{
+public:
+    static constexpr int maxChannels = 2;
+
+    static size_t getArenaBytes(int maximumBlockSize) noexcept
+    {
+        return maxChannels * (DspArena::bytesFor<float>((size_t) (maximumBlockSize + historyLength))
+                              + DspArena::bytesFor<float>((size_t) maximumBlockSize));
+    }
+
+    // Not on the audio thread
+    void prepare(DspArena& arena, double newSampleRate, int maximumBlockSize, int newNumChannels)
+    {
+        sampleRate = newSampleRate;
+        maxBlockSize = maximumBlockSize;
+        numChannels = juce::jmin(maxChannels, newNumChannels);
+        binLength = juce::jmax(1, static_cast<int> (sampleRate * 0.1));
+        idleBlocks = juce::jmax(1, static_cast<int> (2.0 * sampleRate / juce::jmax(1, maximumBlockSize)));
+
+        // BS.1770 pre-filter (high shelf) and RLB weighting (high pass). The standard only lists
+        // 48 kHz coefficients, so both are redesigned from their analog prototypes for this rate.
+        auto k = std::tan(juce::MathConstants<double>::pi * 1681.974450955533 / sampleRate);
+        auto q = 0.7071752369554196;
+        auto vh = std::pow(10.0, 3.999843853973347 / 20.0);
+        auto vb = std::pow(vh, 0.4996667741545416);
+        auto a0 = 1.0 + k / q + k * k;
+
+        juce::dsp::IIR::Coefficients<float> shelf ((float) ((vh + vb * k / q + k * k) / a0), (float) (2.0 * (k * k - vh) / a0), (float) ((vh - vb * k / q + k * k) / a0),
+                                                   1.f, (float) (2.0 * (k * k - 1.0) / a0), (float) ((1.0 - k / q + k * k) / a0));
+
+        k = std::tan(juce::MathConstants<double>::pi * 38.13547087602444 / sampleRate);
+        q = 0.5003270373238773;
+        a0 = 1.0 + k / q + k * k;
+
+        juce::dsp::IIR::Coefficients<float> highPass (1.f, -2.f, 1.f,
+                                                      1.f, (float) (2.0 * (k * k - 1.0) / a0), (float) ((1.0 - k / q + k * k) / a0));
+
+        for( int ch = 0; ch < maxChannels; ++ch )
+        {
+            *shelfFilters[(size_t) ch].coefficients = shelf;
+            *highPassFilters[(size_t) ch].coefficients = highPass;
+            truePeakHistory[(size_t) ch] = arena.take<float>((size_t) (maximumBlockSize + historyLength));
+            weighted[(size_t) ch] = arena.take<float>((size_t) maximumBlockSize);
+        }
+
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        for( int ch = 0; ch < maxChannels; ++ch )
+        {
+            shelfFilters[(size_t) ch].reset();
+            highPassFilters[(size_t) ch].reset();
+
+            if (truePeakHistory[(size_t) ch] != nullptr)
+                juce::FloatVectorOperations::clear(truePeakHistory[(size_t) ch], maxBlockSize + historyLength);
+
+            rmsBins[(size_t) ch].fill(0);
+            peakHold[(size_t) ch] = 0;
+            binSquares[(size_t) ch] = 0;
+            binWeighted[(size_t) ch] = 0;
+        }
+
+        loudnessBins.fill(0);
+        rms.fill(0);
+        lufs = -100.f;
+        truePeakHold = 0;
+        binPosition = 0;
+        binIndex = 0;
+        blocksSinceRead = idleBlocks;
+
+        publish();
+    }
+
+    // Audio thread
+    void process(const juce::dsp::AudioBlock<const float>& block) noexcept
+    {
+        if (blocksSinceRead.load(std::memory_order_relaxed) >= idleBlocks)
+            return;
+
+        blocksSinceRead.fetch_add(1, std::memory_order_relaxed);
+
+        auto channels = juce::jmin(numChannels, static_cast<int> (block.getNumChannels()));
+        auto numSamples = static_cast<int> (block.getNumSamples());
+
+        if (numSamples == 0 || numSamples > maxBlockSize || weighted[0] == nullptr)
+            return;
+
+        auto decay = static_cast<float> (std::pow(10.0, -peakFallDbPerSecond * numSamples / sampleRate / 20.0));
+        truePeakHold *= decay;
+
+        for( int ch = 0; ch < channels; ++ch )
+        {
+            auto* samples = block.getChannelPointer((size_t) ch);
+
+            auto range = juce::FloatVectorOperations::findMinAndMax(samples, numSamples);
+            auto blockPeak = juce::jmax(-range.getStart(), range.getEnd());
+            peakHold[(size_t) ch] = juce::jmax(blockPeak, peakHold[(size_t) ch] * decay);
+
+            truePeakHold = juce::jmax(truePeakHold, blockPeak, findTruePeak(ch, samples, numSamples, blockPeak));
+
+            // K-weighting runs on a copy, the block itself is const
+            auto* weightedSamples = weighted[(size_t) ch];
+            juce::FloatVectorOperations::copy(weightedSamples, samples, numSamples);
+
+            juce::dsp::AudioBlock<float> weightedBlock (&weightedSamples, 1, (size_t) numSamples);
+            juce::dsp::ProcessContextReplacing<float> context (weightedBlock);
+            shelfFilters[(size_t) ch].process(context);
+            highPassFilters[(size_t) ch].process(context);
+        }
+
+        // Sums of squares in 100 ms bins, every channel closing its bin at the same sample
+        for( int start = 0; start < numSamples; )
+        {
+            auto n = juce::jmin(numSamples - start, binLength - binPosition);
+
+            for( int ch = 0; ch < channels; ++ch )
+            {
+                binSquares[(size_t) ch] += sumOfSquares(block.getChannelPointer((size_t) ch) + start, n);
+                binWeighted[(size_t) ch] += sumOfSquares(weighted[(size_t) ch] + start, n);
+            }
+
+            start += n;
+            binPosition += n;
+
+            if (binPosition == binLength)
+                closeBin();
+        }
+
+        publish();
+    }
+
+    // Any thread. Reading is what keeps the meter running.
+    LevelReadings getReadings() const noexcept
+    {
+        blocksSinceRead.store(0, std::memory_order_relaxed);
+
+        LevelReadings readings;
+
+        for( int ch = 0; ch < maxChannels; ++ch )
+        {
+            readings.peak[(size_t) ch] = publishedPeak[(size_t) ch].load(std::memory_order_relaxed);
+            readings.rms[(size_t) ch] = publishedRms[(size_t) ch].load(std::memory_order_relaxed);
+        }
+
+        readings.truePeak = publishedTruePeak.load(std::memory_order_relaxed);
+        readings.shortTermLufs = publishedLufs.load(std::memory_order_relaxed);
+        return readings;
+    }
+
+private:
+    static constexpr double peakFallDbPerSecond = 20.0;
+    static constexpr int numLoudnessBins = 30;     // 3 s of 100 ms bins
+    static constexpr int numRmsBins = 3;           // 300 ms
+
+    // True peak by 4x interpolation with a 12-tap windowed sinc per phase. The interpolator needs
+    // 6 samples either side, so each block evaluates the positions the previous one couldn't
+    // finish plus its own minus the last few.
+    static constexpr int halfTaps = 6;
+    static constexpr int historyLength = 2 * halfTaps - 1;
+
+    struct Interpolator
+    {
+        Interpolator()
+        {
+            for( int phase = 1; phase < 4; ++phase )
+            {
+                float sum = 0;
+
+                for( int k = 0; k < 2 * halfTaps; ++k )
+                {
+                    auto d = static_cast<double> (k - (halfTaps - 1)) - phase / 4.0;
+                    auto sinc = std::abs(d) < 1.0e-9 ? 1.0 : std::sin(juce::MathConstants<double>::pi * d) / (juce::MathConstants<double>::pi * d);
+                    auto window = 0.5 * (1.0 + std::cos(juce::MathConstants<double>::pi * d / halfTaps));
+                    taps[(size_t) phase - 1][(size_t) k] = static_cast<float> (sinc * window);
+                    sum += taps[(size_t) phase - 1][(size_t) k];
+                }
+
+                for( auto& t : taps[(size_t) phase - 1] )
+                    t /= sum;
+            }
+        }
+
+        std::array<std::array<float, 2 * halfTaps>, 3> taps;
+    };
+
+    float findTruePeak(int channel, const float* samples, int numSamples, float blockPeak) noexcept
+    {
+        static const Interpolator interpolator;
+
+        auto* x = truePeakHistory[(size_t) channel];
+        juce::FloatVectorOperations::copy(x + historyLength, samples, numSamples);
+
+        auto length = historyLength + numSamples;
+        auto threshold = 0.5f * juce::jmax(blockPeak, truePeakHold);
+        float peak = 0;
+
+        // Between x[i] and x[i + 1], taps from x[i - 5] to x[i + 6]
+        for( int i = halfTaps - 1; i + halfTaps < length; ++i )
+        {
+            if (std::abs(x[i]) < threshold && std::abs(x[i + 1]) < threshold)
+                continue;
+
+            for( auto& phase : interpolator.taps )
+            {
+                float y = 0;
+
+                for( int k = 0; k < 2 * halfTaps; ++k )
+                    y += phase[(size_t) k] * x[i - (halfTaps - 1) + k];
+
+                peak = juce::jmax(peak, std::abs(y));
+            }
+        }
+
+        // The tail becomes the next block's history
+        std::copy(x + numSamples, x + length, x);
+        return peak;
+    }
+
+    void closeBin() noexcept
+    {
+        double weightedSum = 0;
+
+        for( int ch = 0; ch < maxChannels; ++ch )
+        {
+            rmsBins[(size_t) ch][(size_t) (binIndex % numRmsBins)] = binSquares[(size_t) ch];
+            weightedSum += binWeighted[(size_t) ch];
+
+            binSquares[(size_t) ch] = 0;
+            binWeighted[(size_t) ch] = 0;
+        }
+
+        loudnessBins[(size_t) (binIndex % numLoudnessBins)] = weightedSum;
+        binIndex = (binIndex + 1) % numLoudnessBins;
+        binPosition = 0;
+
+        updateWindows();
+    }
+
+    void updateWindows() noexcept
+    {
+        for( int ch = 0; ch < maxChannels; ++ch )
+        {
+            double sum = 0;
+
+            for( auto bin : rmsBins[(size_t) ch] )
+                sum += bin;
+
+            rms[(size_t) ch] = static_cast<float> (std::sqrt(sum / (numRmsBins * binLength)));
+        }
+
+        double loudness = 0;
+
+        for( auto bin : loudnessBins )
+            loudness += bin;
+
+        loudness /= numLoudnessBins * binLength;
+        lufs = loudness > 1.0e-10 ? static_cast<float> (-0.691 + 10.0 * std::log10(loudness)) : -100.f;
+    }
+
+    void publish() noexcept
+    {
+        for( int ch = 0; ch < maxChannels; ++ch )
+        {
+            publishedPeak[(size_t) ch].store(peakHold[(size_t) ch], std::memory_order_relaxed);
+            publishedRms[(size_t) ch].store(rms[(size_t) ch], std::memory_order_relaxed);
+        }
+
+        publishedTruePeak.store(truePeakHold, std::memory_order_relaxed);
+        publishedLufs.store(lufs, std::memory_order_relaxed);
+    }
+
+    double sampleRate {44100};
+    int numChannels {0};
+    int binLength {4410};
+    int idleBlocks {1};
+    int maxBlockSize {0};
+
+    std::array<juce::dsp::IIR::Filter<float>, maxChannels> shelfFilters, highPassFilters;
+    // In the processor's DspArena
+    std::array<float*, maxChannels> truePeakHistory {};
+    std::array<float*, maxChannels> weighted {};
+
+    std::array<float, maxChannels> peakHold {};
+    float truePeakHold {0};
+
+    int binPosition {0};
+    int binIndex {0};
+    std::array<double, maxChannels> binSquares {}, binWeighted {};
+    std::array<std::array<double, numRmsBins>, maxChannels> rmsBins {};
+    std::array<double, numLoudnessBins> loudnessBins {};
+    std::array<float, maxChannels> rms {};
+    float lufs {-100.f};
+
+    // Written by readers as well, so kept off the audio thread's cache lines
+    alignas(DspArena::cacheLineBytes) std::array<std::atomic<float>, maxChannels> publishedPeak {}, publishedRms {};
+    std::atomic<float> publishedTruePeak {0}, publishedLufs {-100.f};
+    mutable std::atomic<int> blocksSinceRead {0};
+};
@@ -0,0 +1,299 @@
+/*
+  ==============================================================================
+
+    Modulation.h
+    Created: 11 Sep 2022 2:25:37pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include "DspArena.h"
+#include "Trace.h"
+
+enum class ModSource
+{
+    None,
+    Lfo,
+    Envelope,
+    StepSequencer
+};
+
+enum class ModTarget
+{
+    Cutoff,
+    Resonance
+};
+
+enum class LfoShape
+{
+    Sine,
+    Triangle,
+    Saw,
+    Square
+};
+
+// Note lengths offered for tempo sync, in beats
+inline constexpr std::array<float, 6> syncDivisionBeats { 0.25f, 0.5f, 1.f, 2.f, 4.f, 8.f };
+
+struct ModulationSettings
+{
+    static constexpr int numSlots = 4;
+    static constexpr int numSequencerSteps = 8;
+
+    struct Slot
+    {
+        ModSource source {ModSource::None};
+        ModTarget target {ModTarget::Cutoff};
+        float depth {0};
+    };
+
+    LfoShape lfoShape {LfoShape::Sine};
+    bool lfoSync {false};
+    float lfoRate {1.f};        // Hz when free running
+    float lfoBeats {1.f};       // beats per cycle when synced
+
+    juce::ADSR::Parameters envelope;
+
+    float sequencerBeats {0.25f};   // beats per step
+    std::array<float, numSequencerSteps> sequencerSteps {};
+
+    std::array<Slot, numSlots> slots;
+};
+
+// LFO, ADSR and step sequencer rendered a block at a time at control rate, then summed
+// through the matrix into per-step cutoff (octaves) and resonance offsets.
+// Everything is sized in prepare(), process() never allocates.
+class ModulationEngine
+{
+public:
+    // Full-depth slot moves the cutoff this many octaves, resonance this much
+    static constexpr float cutoffOctavesPerUnit = 4.f;
+    static constexpr float resonancePerUnit = 5.f;
+
+    struct Transport
+    {
+        double bpm {120};
+        double ppqPosition {0};
+        bool isPlaying {false};
+    };
+
+    static size_t getArenaBytes(int maxSteps) noexcept
+    {
+        return 6 * DspArena::bytesFor<float>((size_t) maxSteps);
+    }
+
+    void prepare(DspArena& arena, double newSampleRate, int newControlInterval, int newMaxSteps)
+    {
+        sampleRate = newSampleRate;
+        controlInterval = newControlInterval;
+        maxSteps = newMaxSteps;
+
+        for( auto& buffer : sourceBuffers )
+            buffer = arena.take<float>((size_t) maxSteps);
+
+        cutoffOctaves = arena.take<float>((size_t) maxSteps);
+        resonanceOffsets = arena.take<float>((size_t) maxSteps);
+
+        // juce::ADSR advances one "sample" per call, so clock it at the control rate
+        adsr.setSampleRate(sampleRate / controlInterval);
+        reset();
+    }
+
+    void reset()
+    {
+        lfoPhase = 0;
+        sequencerPhase = 0;
+        adsr.reset();
+        heldNotes = 0;
+    }
+
+    int getMaxSteps() const noexcept { return maxSteps; }
+
+    // Everything that carries over from one block to the next
+    struct State
+    {
+        double lfoPhase;
+        double sequencerPhase;
+        juce::ADSR adsr;
+        int heldNotes;
+    };
+
+    State getState() const noexcept { return { lfoPhase, sequencerPhase, adsr, heldNotes }; }
+
+    void setState(const State& state) noexcept
+    {
+        lfoPhase = state.lfoPhase;
+        sequencerPhase = state.sequencerPhase;
+        adsr = state.adsr;
+        heldNotes = state.heldNotes;
+    }
+
+    static bool targets(const ModulationSettings& settings, ModTarget target) noexcept
+    {
+        for( auto& slot : settings.slots )
+            if (slot.source != ModSource::None && slot.depth != 0 && slot.target == target)
+                return true;
+
+        return false;
+    }
+
+    // Renders control steps for numSamples starting at startSample within the host block (transport
+    // is for startSample). MIDI notes gate the envelope at step resolution.
+    void process(const ModulationSettings& settings,
+                 const Transport& transport,
+                 const juce::MidiBuffer& midi,
+                 int startSample,
+                 int numSamples) noexcept
+    {
+        FP_TRACE_SCOPE("modulation");
+
+        auto numSteps = juce::jmin(maxSteps, (numSamples + controlInterval - 1) / controlInterval);
+        auto stepsPerSecond = sampleRate / controlInterval;
+        auto beatsPerStep = transport.bpm / 60.0 / stepsPerSecond;
+
+        // Synced sources follow the host position while it plays, otherwise they free-run at its tempo
+        if (transport.isPlaying)
+        {
+            if (settings.lfoSync)
+                lfoPhase = wrap(transport.ppqPosition / settings.lfoBeats);
+
+            sequencerPhase = wrap(transport.ppqPosition / (settings.sequencerBeats * ModulationSettings::numSequencerSteps));
+        }
+
+        auto lfoIncrement = settings.lfoSync ? beatsPerStep / settings.lfoBeats
+                                             : settings.lfoRate / stepsPerSecond;
+        renderLfo(settings.lfoShape, sourceBuffers[(size_t) ModSource::Lfo], numSteps, lfoIncrement);
+
+        renderEnvelope(settings.envelope, sourceBuffers[(size_t) ModSource::Envelope], numSteps, midi, startSample);
+
+        auto sequencerIncrement = beatsPerStep / (settings.sequencerBeats * ModulationSettings::numSequencerSteps);
+        renderSequencer(settings.sequencerSteps, sourceBuffers[(size_t) ModSource::StepSequencer], numSteps, sequencerIncrement);
+
+        juce::FloatVectorOperations::clear(cutoffOctaves, numSteps);
+        juce::FloatVectorOperations::clear(resonanceOffsets, numSteps);
+
+        for( auto& slot : settings.slots )
+        {
+            if (slot.source == ModSource::None || slot.depth == 0)
+                continue;
+
+            auto* dest = slot.target == ModTarget::Cutoff ? cutoffOctaves : resonanceOffsets;
+            auto scale = slot.target == ModTarget::Cutoff ? cutoffOctavesPerUnit : resonancePerUnit;
+
+            juce::FloatVectorOperations::addWithMultiply(dest, sourceBuffers[(size_t) slot.source], slot.depth * scale, numSteps);
+        }
+    }
+
+    const float* getCutoffOctaves() const noexcept { return cutoffOctaves; }
+    const float* getResonanceOffsets() const noexcept { return resonanceOffsets; }
+
+private:
+    static double wrap(double phase) noexcept { return phase - std::floor(phase); }
+
+    void renderLfo(LfoShape shape, float* dest, int numSteps, double increment) noexcept
+    {
+        auto start = static_cast<float> (lfoPhase);
+        auto inc = static_cast<float> (increment);
+
+        // One branch per block, the per-step loops are straight-line and vectorise
+        switch (shape)
+        {
+            case LfoShape::Sine:
+                for( int i = 0; i < numSteps; ++i )
+                    dest[i] = std::sin(juce::MathConstants<float>::twoPi * (start + inc * static_cast<float> (i)));
+                break;
+
+            case LfoShape::Triangle:
+                for( int i = 0; i < numSteps; ++i )
+                {
+                    auto p = start + inc * static_cast<float> (i);
+                    p -= std::floor(p);
+                    dest[i] = 1.f - 4.f * std::abs(p - 0.5f);
+                }
+                break;
+
+            case LfoShape::Saw:
+                for( int i = 0; i < numSteps; ++i )
+                {
+                    auto p = start + inc * static_cast<float> (i);
+                    dest[i] = 2.f * (p - std::floor(p)) - 1.f;
+                }
+                break;
+
+            case LfoShape::Square:
+                for( int i = 0; i < numSteps; ++i )
+                {
+                    auto p = start + inc * static_cast<float> (i);
+                    dest[i] = (p - std::floor(p)) < 0.5f ? 1.f : -1.f;
+                }
+                break;
+        }
+
+        lfoPhase = wrap(lfoPhase + increment * numSteps);
+    }
+
+    void renderEnvelope(const juce::ADSR::Parameters& parameters, float* dest, int numSteps, const juce::MidiBuffer& midi, int startSample) noexcept
+    {
+        adsr.setParameters(parameters);
+
+        // Events before startSample were consumed by the previous call for this block
+        auto event = midi.findNextSamplePosition(startSample);
+
+        for( int step = 0; step < numSteps; ++step )
+        {
+            auto stepEnd = startSample + (step + 1) * controlInterval;
+
+            for( ; event != midi.cend() && (*event).samplePosition < stepEnd; ++event )
+            {
+                auto message = (*event).getMessage();
+
+                if (message.isNoteOn())
+                {
+                    if (heldNotes++ == 0)
+                        adsr.noteOn();
+                }
+                else if (message.isNoteOff() && heldNotes > 0)
+                {
+                    if (--heldNotes == 0)
+                        adsr.noteOff();
+                }
+                else if (message.isAllNotesOff())
+                {
+                    heldNotes = 0;
+                    adsr.noteOff();
+                }
+            }
+
+            dest[step] = adsr.getNextSample();
+        }
+    }
+
+    void renderSequencer(const std::array<float, ModulationSettings::numSequencerSteps>& steps, float* dest, int numSteps, double increment) noexcept
+    {
+        for( int i = 0; i < numSteps; ++i )
+        {
+            auto index = static_cast<int> (wrap(sequencerPhase + increment * i) * ModulationSettings::numSequencerSteps);
+            dest[i] = steps[(size_t) juce::jlimit(0, ModulationSettings::numSequencerSteps - 1, index)];
+        }
+
+        sequencerPhase = wrap(sequencerPhase + increment * numSteps);
+    }
+
+    double sampleRate {44100};
+    int controlInterval {32};
+    int maxSteps {0};
+
+    // Indexed by ModSource, the None entry stays silent. All in the processor's DspArena.
+    std::array<float*, 4> sourceBuffers {};
+    float* cutoffOctaves {nullptr};
+    float* resonanceOffsets {nullptr};
+
+    double lfoPhase {0};
+    double sequencerPhase {0};
+    juce::ADSR adsr;
+    int heldNotes {0};
+};
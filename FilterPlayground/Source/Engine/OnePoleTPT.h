@@ -0,0 +1,236 @@
+/*
+  ==============================================================================
+
+    OnePoleTPT.h
+    Created: 18 Sep 2022 10:04:26am
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+// First-order TPT (trapezoidal) low-pass, the structure CustomFilter's alpha = g / (1 + g) is for:
+//   v = (x - s) * alpha,  y = v + s,  s' = y + v
+namespace OnePoleTPT
+{
+    // Coefficient-constant block. Written as four-sample steps in closed form: with c = 1 - 2 alpha,
+    //   s[k] = c^k s[0] + 2 alpha * sum_j c^(k-1-j) x[j]
+    //   y[k] = alpha x[k] + (1 - alpha) s[k]
+    // so the four outputs of a step only depend on s[0] and the inputs, which leaves one
+    // multiply-add per four samples on the serial path and lets the compiler vectorise the rest.
+    inline float process(float s, float alpha, const float* in, float* out, int numSamples) noexcept
+    {
+        const float c = 1.f - 2.f * alpha;
+        const float b = 2.f * alpha;
+        const float d = 1.f - alpha;
+
+        const float c2 = c * c, c3 = c2 * c, c4 = c2 * c2;
+
+        int i = 0;
+
+        for( ; i + 4 <= numSamples; i += 4 )
+        {
+            const float x0 = in[i], x1 = in[i + 1], x2 = in[i + 2], x3 = in[i + 3];
+
+            const float s1 = c  * s + b * x0;
+            const float s2 = c2 * s + b * (c * x0 + x1);
+            const float s3 = c3 * s + b * (c2 * x0 + c * x1 + x2);
+            const float s4 = c4 * s + b * (c3 * x0 + c2 * x1 + c * x2 + x3);
+
+            out[i]     = alpha * x0 + d * s;
+            out[i + 1] = alpha * x1 + d * s1;
+            out[i + 2] = alpha * x2 + d * s2;
+            out[i + 3] = alpha * x3 + d * s3;
+
+            s = s4;
+        }
+
+        for( ; i < numSamples; ++i )
+        {
+            const float v = (in[i] - s) * alpha;
+            const float y = v + s;
+            s = y + v;
+            out[i] = y;
+        }
+
+        return s;
+    }
+
+    // Per-sample coefficient ramp from alphaStart towards alphaEnd, reached on the last sample
+    inline float processRamp(float s, float alphaStart, float alphaEnd, const float* in, float* out, int numSamples) noexcept
+    {
+        const float step = numSamples > 0 ? (alphaEnd - alphaStart) / static_cast<float> (numSamples) : 0.f;
+        float alpha = alphaStart;
+
+        for( int i = 0; i < numSamples; ++i )
+        {
+            alpha += step;
+
+            const float v = (in[i] - s) * alpha;
+            const float y = v + s;
+            s = y + v;
+            out[i] = y;
+        }
+
+        return s;
+    }
+
+    // Two channels at the same alpha in one loop: process()'s four-sample steps for both, so the
+    // two serial multiply-adds overlap in the pipeline
+    inline void processStereo(float& sL, float& sR, float alpha, float* left, float* right, int numSamples) noexcept
+    {
+        const float c = 1.f - 2.f * alpha;
+        const float b = 2.f * alpha;
+        const float d = 1.f - alpha;
+
+        const float c2 = c * c, c3 = c2 * c, c4 = c2 * c2;
+
+        float l = sL, r = sR;
+        int i = 0;
+
+        for( ; i + 4 <= numSamples; i += 4 )
+        {
+            const float l0 = left[i], l1 = left[i + 1], l2 = left[i + 2], l3 = left[i + 3];
+            const float r0 = right[i], r1 = right[i + 1], r2 = right[i + 2], r3 = right[i + 3];
+
+            const float lS1 = c  * l + b * l0;
+            const float lS2 = c2 * l + b * (c * l0 + l1);
+            const float lS3 = c3 * l + b * (c2 * l0 + c * l1 + l2);
+            const float lS4 = c4 * l + b * (c3 * l0 + c2 * l1 + c * l2 + l3);
+
+            const float rS1 = c  * r + b * r0;
+            const float rS2 = c2 * r + b * (c * r0 + r1);
+            const float rS3 = c3 * r + b * (c2 * r0 + c * r1 + r2);
+            const float rS4 = c4 * r + b * (c3 * r0 + c2 * r1 + c * r2 + r3);
+
+            left[i]     = alpha * l0 + d * l;
+            left[i + 1] = alpha * l1 + d * lS1;
+            left[i + 2] = alpha * l2 + d * lS2;
+            left[i + 3] = alpha * l3 + d * lS3;
+
+            right[i]     = alpha * r0 + d * r;
+            right[i + 1] = alpha * r1 + d * rS1;
+            right[i + 2] = alpha * r2 + d * rS2;
+            right[i + 3] = alpha * r3 + d * rS3;
+
+            l = lS4;
+            r = rS4;
+        }
+
+        for( ; i < numSamples; ++i )
+        {
+            const float vL = (left[i] - l) * alpha;
+            const float vR = (right[i] - r) * alpha;
+            const float yL = vL + l;
+            const float yR = vR + r;
+            l = yL + vL;
+            r = yR + vR;
+            left[i] = yL;
+            right[i] = yR;
+        }
+
+        sL = l;
+        sR = r;
+    }
+}
+
+// Kernel signatures, so FilterKernels.h can hand in a version compiled for a wider ISA
+using OnePoleProcessFn = decltype(&OnePoleTPT::process);
+using OnePoleRampFn = decltype(&OnePoleTPT::processRamp);
+
+// Plain-old-data filter state, one cache line so neighbouring instances never share one
+struct alignas(64) OnePoleState
+{
+    float s;
+    float alpha;
+    float targetAlpha;
+};
+
+// Drop-in processor for a juce::dsp::ProcessorChain slot (prepare/reset/process), mono.
+// setAlpha() takes effect immediately, setTargetAlpha() ramps per sample over the next block.
+class OnePoleLowPass
+{
+public:
+    OnePoleLowPass()
+    {
+        state.s = 0;
+        state.alpha = state.targetAlpha = 1.f;
+    }
+
+    void prepare(const juce::dsp::ProcessSpec& spec) noexcept
+    {
+        jassert (spec.numChannels == 1);
+        juce::ignoreUnused(spec);
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        state.s = 0;
+    }
+
+    void setAlpha(float alpha) noexcept
+    {
+        state.alpha = state.targetAlpha = alpha;
+    }
+
+    void setTargetAlpha(float alpha) noexcept
+    {
+        state.targetAlpha = alpha;
+    }
+
+    float getAlpha() const noexcept { return state.alpha; }
+
+    // Picked once in prepareToPlay, see FilterKernelDispatch
+    void setKernels(OnePoleProcessFn newProcess, OnePoleRampFn newRamp) noexcept
+    {
+        processKernel = newProcess;
+        rampKernel = newRamp;
+    }
+
+    OnePoleState& getState() noexcept { return state; }
+    const OnePoleState& getState() const noexcept { return state; }
+
+    template <typename ProcessContext>
+    void process(const ProcessContext& context) noexcept
+    {
+        auto&& inputBlock = context.getInputBlock();
+        auto&& outputBlock = context.getOutputBlock();
+
+        jassert (inputBlock.getNumChannels() == 1 && outputBlock.getNumChannels() == 1);
+        jassert (inputBlock.getNumSamples() == outputBlock.getNumSamples());
+
+        auto numSamples = static_cast<int> (inputBlock.getNumSamples());
+        auto* in = inputBlock.getChannelPointer(0);
+        auto* out = outputBlock.getChannelPointer(0);
+
+        if (context.isBypassed)
+        {
+            if (context.usesSeparateInputAndOutputBlocks())
+                outputBlock.copyFrom(inputBlock);
+
+            return;
+        }
+
+        if (state.targetAlpha != state.alpha)
+        {
+            state.s = rampKernel(state.s, state.alpha, state.targetAlpha, in, out, numSamples);
+            state.alpha = state.targetAlpha;
+        }
+        else
+        {
+            state.s = processKernel(state.s, state.alpha, in, out, numSamples);
+        }
+
+        // Flush denormals out of the state so a silent tail doesn't slow down
+        if (std::abs(state.s) < 1.0e-15f)
+            state.s = 0;
+    }
+
+private:
+    OnePoleState state;
+    OnePoleProcessFn processKernel {OnePoleTPT::process};
+    OnePoleRampFn rampKernel {OnePoleTPT::processRamp};
+};
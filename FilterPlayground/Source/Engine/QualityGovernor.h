@@ -0,0 +1,184 @@
+/*
+  ==============================================================================
+
+    QualityGovernor.h
+    Created: 12 Oct 2022 9:26:40pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include "SharedResources.h"
+
+// What each tier trades away. Modulated cutoffs are recomputed less often, and the ladder drops
+// its antiderivative antialiasing at Minimum (LadderFilter fades between the two).
+enum class QualityTier
+{
+    Full,       // cutoff modulation recomputed every control step, ramped per sample; antialiased ladder
+    Reduced,    // every 4 control steps, ramped; antialiased ladder
+    Minimum     // every 8 control steps, stepped (closed-form kernel, no per-sample ramp); plain ladder
+};
+
+enum class QualityMode
+{
+    Adaptive,
+    Full,
+    Reduced,
+    Minimum
+};
+
+// When to step down and back up. The load that decides it is the whole session's: the summed
+// processBlock time of every instance in the process (SessionLoad) over the wall-clock time
+// between this instance's blocks, smoothed over a few blocks. A big session of cheap instances
+// nearing its deadline is what the tiers are for, and there no one instance's own share comes
+// near a threshold. 1.0 is one core's worth of real time. Hosts that spread the session over
+// several audio threads can pass that without anything arriving late, so the thresholds are set
+// low enough to engage for a host running it all on one. Stepping down reacts within a handful
+// of blocks, stepping back up needs a much longer quiet spell so the tier doesn't flap.
+struct QualityPolicy
+{
+    double stepDownLoad {0.5};
+    double stepUpLoad {0.2};
+    double smoothing {0.2};          // one-pole weight of the newest block
+    int blocksBeforeStepDown {4};
+    int blocksBeforeStepUp {400};
+};
+
+// Audio thread calls update() once per block with when the block started and finished; anyone
+// can read the tier and loads back (editor, host tooling).
+class QualityGovernor
+{
+public:
+    static int getStepsPerCoefficientUpdate(QualityTier tier) noexcept
+    {
+        switch (tier)
+        {
+            case QualityTier::Full:    return 1;
+            case QualityTier::Reduced: return 4;
+            case QualityTier::Minimum: return 8;
+        }
+
+        return 1;
+    }
+
+    static bool rampsCoefficients(QualityTier tier) noexcept { return tier != QualityTier::Minimum; }
+
+    // Every instance's governor shares the one SessionLoad, see SharedDspResources
+    void prepare(double newSampleRate, SessionLoad& newSessionLoad) noexcept
+    {
+        sampleRate = newSampleRate;
+        sessionLoad = &newSessionLoad;
+        reset();
+    }
+
+    void reset() noexcept
+    {
+        smoothedLoad = smoothedSessionLoad = 0;
+        lastEndTicks = lastSessionTicks = 0;
+        blocksOverBudget = blocksUnderBudget = 0;
+        adaptiveTier = QualityTier::Full;
+        publish(mode == QualityMode::Adaptive ? adaptiveTier : fixedTier(mode));
+    }
+
+    void setPolicy(const QualityPolicy& newPolicy) noexcept { policy = newPolicy; }
+    const QualityPolicy& getPolicy() const noexcept { return policy; }
+
+    // Fixed modes pin the tier, Adaptive picks up from wherever the governor last was
+    void setMode(QualityMode newMode) noexcept
+    {
+        if (newMode == mode)
+            return;
+
+        mode = newMode;
+        blocksOverBudget = blocksUnderBudget = 0;
+        publish(mode == QualityMode::Adaptive ? adaptiveTier : fixedTier(mode));
+    }
+
+    QualityMode getMode() const noexcept { return mode; }
+
+    void update(int numSamples, juce::int64 startTicks, juce::int64 endTicks) noexcept
+    {
+        if (numSamples <= 0 || sampleRate <= 0 || sessionLoad == nullptr)
+            return;
+
+        auto budget = juce::jmax((juce::int64) 1, juce::Time::secondsToHighResolutionTicks(numSamples / sampleRate));
+        auto elapsed = endTicks - startTicks;
+        auto load = static_cast<double> (elapsed) / static_cast<double> (budget);
+
+        // Everyone's processing since this instance's last block, this one included, over the
+        // time that passed. Blocks coming faster than real time (offline) count against their own
+        // duration instead. The first block after a reset has nothing to go on but itself.
+        auto sessionTicks = sessionLoad->addBusyTicks(elapsed);
+        auto session = load;
+
+        if (lastEndTicks != 0)
+            session = static_cast<double> (sessionTicks - lastSessionTicks)
+                    / static_cast<double> (juce::jmax(budget, endTicks - lastEndTicks));
+
+        lastEndTicks = endTicks;
+        lastSessionTicks = sessionTicks;
+
+        smoothedLoad += policy.smoothing * (load - smoothedLoad);
+        smoothedSessionLoad += policy.smoothing * (session - smoothedSessionLoad);
+        currentLoad.store(static_cast<float> (smoothedLoad), std::memory_order_relaxed);
+        currentSessionLoad.store(static_cast<float> (smoothedSessionLoad), std::memory_order_relaxed);
+
+        if (mode != QualityMode::Adaptive)
+            return;
+
+        blocksOverBudget = smoothedSessionLoad > policy.stepDownLoad ? blocksOverBudget + 1 : 0;
+        blocksUnderBudget = smoothedSessionLoad < policy.stepUpLoad ? blocksUnderBudget + 1 : 0;
+
+        if (blocksOverBudget >= policy.blocksBeforeStepDown && adaptiveTier != QualityTier::Minimum)
+        {
+            adaptiveTier = static_cast<QualityTier> (static_cast<int> (adaptiveTier) + 1);
+            blocksOverBudget = 0;
+        }
+        else if (blocksUnderBudget >= policy.blocksBeforeStepUp && adaptiveTier != QualityTier::Full)
+        {
+            adaptiveTier = static_cast<QualityTier> (static_cast<int> (adaptiveTier) - 1);
+            blocksUnderBudget = 0;
+        }
+
+        publish(adaptiveTier);
+    }
+
+    QualityTier getTier() const noexcept { return currentTier.load(std::memory_order_relaxed); }
+
+    // This instance's own processBlock time over the block's duration, and the session's, which
+    // is what the adaptive mode goes by
+    float getLoad() const noexcept { return currentLoad.load(std::memory_order_relaxed); }
+    float getSessionLoad() const noexcept { return currentSessionLoad.load(std::memory_order_relaxed); }
+
+private:
+    static QualityTier fixedTier(QualityMode m) noexcept
+    {
+        switch (m)
+        {
+            case QualityMode::Reduced: return QualityTier::Reduced;
+            case QualityMode::Minimum: return QualityTier::Minimum;
+            case QualityMode::Full:
+            case QualityMode::Adaptive: break;
+        }
+
+        return QualityTier::Full;
+    }
+
+    void publish(QualityTier tier) noexcept { currentTier.store(tier, std::memory_order_relaxed); }
+
+    double sampleRate {0};
+    SessionLoad* sessionLoad {nullptr};
+    QualityPolicy policy;
+    QualityMode mode {QualityMode::Full};
+
+    double smoothedLoad {0}, smoothedSessionLoad {0};
+    juce::int64 lastEndTicks {0}, lastSessionTicks {0};
+    int blocksOverBudget {0}, blocksUnderBudget {0};
+    QualityTier adaptiveTier {QualityTier::Full};
+
+    std::atomic<QualityTier> currentTier {QualityTier::Full};
+    std::atomic<float> currentLoad {0}, currentSessionLoad {0};
+};
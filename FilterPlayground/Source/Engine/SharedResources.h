@@ -0,0 +1,131 @@
+/*
+  ==============================================================================
+
+    SharedResources.h
+    Created: 14 Aug 2022 6:02:11pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+// Bilinear-transform one-pole design, alpha = g / (1 + g) with g = tan(pi * fc / fs).
+// Kept here so the lookup tables and the direct path can't drift apart.
+inline float designOnePoleAlpha(double sampleRate, float cFreq)
+{
+    float wd = 2 * juce::MathConstants<float>::pi * cFreq;
+    float T = 1/sampleRate;
+    float wa = (2/T) * std::tan(wd*T/2);
+    float g = wa * T/2;
+
+    return g /(1.0 + g);
+}
+
+// Alpha for every integer cutoff from 0 Hz up to Nyquist (or 20 kHz, whichever is lower).
+// "LowPass Freq" has a 1 Hz step, so lookups for parameter values land exactly on a table entry,
+// modulated cutoffs are linearly interpolated.
+struct OnePoleAlphaTable
+{
+    double sampleRate {0};
+    std::vector<float> alphas;
+
+    inline float lookup(float cFreq) const
+    {
+        auto maxIndex = static_cast<float> (alphas.size() - 1);
+        auto pos = juce::jlimit(0.f, maxIndex, cFreq);
+        auto index = static_cast<int> (pos);
+        auto frac = pos - static_cast<float> (index);
+
+        if (index >= static_cast<int> (alphas.size()) - 1)
+            return alphas.back();
+
+        return alphas[(size_t) index] + frac * (alphas[(size_t) index + 1] - alphas[(size_t) index]);
+    }
+};
+
+// Time every instance in the process has spent in processBlock, summed over all of them and
+// whichever threads the host runs them on. Each QualityGovernor adds its own blocks and reads how
+// far the total moved since its previous block, which tells it how busy the whole session is
+// even when no single instance costs much.
+class SessionLoad
+{
+public:
+    // Any thread. Adds a block's processing time and returns the new total.
+    juce::int64 addBusyTicks(juce::int64 ticks) noexcept
+    {
+        return busyTicks.fetch_add(ticks, std::memory_order_relaxed) + ticks;
+    }
+
+private:
+    std::atomic<juce::int64> busyTicks {0};
+};
+
+// Process-wide registry of immutable DSP assets: coefficient tables and windows. FFT objects
+// aren't in here, each SpectralFilter layout owns its own (see SpectralFilter). It also holds
+// the SessionLoad counter, the one mutable thing the instances share.
+// Every plugin instance holds a juce::SharedResourcePointer<SharedDspResources>, so the
+// registry lives as long as at least one instance does and each asset is built once per process.
+//
+// Getters lock and may allocate, call them from prepareToPlay or other non-audio threads.
+// What they hand out is const and ref-counted, so the audio thread can read it freely.
+class SharedDspResources
+{
+public:
+    static constexpr float maxTableFrequency = 20000.f;
+
+    std::shared_ptr<const OnePoleAlphaTable> getOnePoleAlphaTable(double sampleRate)
+    {
+        const juce::ScopedLock sl (lock);
+
+        auto& entry = alphaTables[sampleRate];
+        if (entry != nullptr)
+            return entry;
+
+        auto table = std::make_shared<OnePoleAlphaTable>();
+        table->sampleRate = sampleRate;
+
+        auto maxFreq = juce::jmin(maxTableFrequency, static_cast<float> (sampleRate * 0.5) - 1.f);
+        auto numEntries = static_cast<size_t> (maxFreq) + 1;
+        table->alphas.resize(numEntries);
+
+        for( size_t i = 0; i < numEntries; ++i )
+            table->alphas[i] = designOnePoleAlpha(sampleRate, static_cast<float> (i));
+
+        entry = table;
+        return entry;
+    }
+
+    using WindowType = juce::dsp::WindowingFunction<float>::WindowingMethod;
+
+    std::shared_ptr<const std::vector<float>> getWindow(int size, WindowType type)
+    {
+        jassert (size > 0);
+        const juce::ScopedLock sl (lock);
+
+        auto& entry = windows[{ size, static_cast<int> (type) }];
+        if (entry != nullptr)
+            return entry;
+
+        auto window = std::make_shared<std::vector<float>>(static_cast<size_t> (size));
+        juce::dsp::WindowingFunction<float>::fillWindowingTables(window->data(), static_cast<size_t> (size), type, false);
+
+        entry = window;
+        return entry;
+    }
+
+    // Lock-free, for the audio thread
+    SessionLoad& getSessionLoad() noexcept { return sessionLoad; }
+
+private:
+    juce::CriticalSection lock;
+    SessionLoad sessionLoad;
+
+    std::map<double, std::shared_ptr<const OnePoleAlphaTable>> alphaTables;
+    std::map<std::pair<int, int>, std::shared_ptr<const std::vector<float>>> windows;
+};
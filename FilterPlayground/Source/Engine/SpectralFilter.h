@@ -0,0 +1,602 @@
+/*
+  ==============================================================================
+
+    SpectralFilter.h
+    Created: 26 Oct 2022 8:14:55pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "DspArena.h"
+#include "SharedResources.h"
+
+enum class SpectralMode
+{
+    DynamicLowPass,     // 24 dB/oct above the cutoff, except bins louder than the threshold
+    Gate                // bins quieter than the threshold are pulled down, everywhere
+};
+
+enum class SpectralWindow
+{
+    Hann,
+    Hamming,
+    BlackmanHarris
+};
+
+// FFT size, overlap and window the filter runs with, packed into one int when it has to cross
+// threads in an atomic. An order of 0 is no layout at all.
+struct SpectralLayoutSettings
+{
+    int order {0};
+    int overlap {4};
+    SpectralWindow window {SpectralWindow::Hann};
+
+    int pack() const noexcept { return order == 0 ? 0 : order | (overlap << 8) | (static_cast<int> (window) << 16); }
+
+    static SpectralLayoutSettings unpack(int packed) noexcept
+    {
+        return { packed & 0xff, (packed >> 8) & 0xff, static_cast<SpectralWindow> (packed >> 16) };
+    }
+};
+
+// Streaming STFT with a per-bin gain, overlap-added back to a continuous signal.
+//
+// Every hop the last fftSize input samples are windowed and transformed, each bin gets a gain
+// from its own power against the threshold (and, in DynamicLowPass mode, the low-pass shape),
+// and the inverse is windowed again and added into the output accumulator. The synthesis window
+// is divided by the summed squared windows at its hop position, so with all gains at 1 the output
+// is the input delayed by exactly fftSize samples, whatever the window and overlap.
+//
+// Gains move towards their target with a per-frame attack/release so gated bins don't chatter.
+//
+// A layout (one FFT size, overlap and window) is built off the audio thread by setLayout(): its
+// own juce::dsp::FFT, since perform calls on JUCE's fallback engine take a SpinLock and a plan
+// shared between instances would serialise them, the window from SharedDspResources, and frame
+// buffers sized for that FFT only. Until one arrives the audio thread keeps running the old
+// layout (or passes the input through when there was none); then it runs both, waits for the new
+// one's first FFT length of output to come through and crossfades to it over crossfadeSeconds,
+// and hands the old one back to be freed on the next setLayout(), the way FilterGraphPlayer swaps
+// graphs, so nothing is allocated or freed on the audio thread. With no layout (outside Spectral
+// mode) the filter holds no memory. The channels' hops are staggered by half a hop, so with hops
+// longer than the host block their transforms land in different blocks rather than doubling up
+// in one.
+class SpectralFilter
+{
+public:
+    static constexpr int maxChannels = 2;
+    static constexpr int minOrder = 8, maxOrder = 12;       // 256 to 4096 points
+    static constexpr int maxSize = 1 << maxOrder;
+    static constexpr int maxBins = maxSize / 2 + 1;
+
+    static constexpr float floorGain = 0.001f;             // -60 dB, what a gated bin goes down to
+    static constexpr double attackSeconds = 0.005;
+    static constexpr double releaseSeconds = 0.12;
+    static constexpr double crossfadeSeconds = 0.02;
+
+    SpectralFilter() = default;
+
+    ~SpectralFilter()
+    {
+        abandonCrossfade();
+        delete pending.exchange(nullptr);
+        delete retired.exchange(nullptr);
+    }
+
+    static size_t getArenaBytes(int maximumBlockSize) noexcept
+    {
+        return maxChannels * DspArena::bytesFor<float>((size_t) maximumBlockSize);
+    }
+
+    // Message thread, with the audio thread stopped (prepareToPlay). Drops the layout.
+    void prepare(DspArena& arena, SharedDspResources& sharedResources, double newSampleRate, int maximumBlockSize)
+    {
+        resources = &sharedResources;
+        sampleRate = newSampleRate;
+        crossfadeLength = juce::jmax(1, static_cast<int> (newSampleRate * crossfadeSeconds));
+        fadeSamples = maximumBlockSize;
+
+        for( auto& channel : fadeBuffer )
+            channel = arena.take<float>((size_t) maximumBlockSize);
+
+        abandonCrossfade();
+        delete pending.exchange(nullptr);
+        delete retired.exchange(nullptr);
+        active.reset();
+        activeSettings = {};
+        activeBytes = 0;
+        pendingBytes = 0;
+        activeStateSize = 0;
+        pendingStateSize = 0;
+    }
+
+    // Off the audio thread, after prepare() and never from two threads at once. Builds the layout
+    // and queues it for the audio thread, which starts its frames from silence; an order of 0
+    // drops the current one. Allocates: the message thread, or an offline render's own thread.
+    void setLayout(SpectralLayoutSettings settings)
+    {
+        jassert (resources != nullptr);
+        collectGarbage();
+
+        std::unique_ptr<Layout> layout;
+
+        if (settings.order != 0)
+        {
+            settings.order = juce::jlimit(minOrder, maxOrder, settings.order);
+            settings.overlap = juce::jlimit(2, 8, settings.overlap);
+            layout = std::make_unique<Layout>(settings, sampleRate, *resources);
+        }
+
+        pendingBytes = layout != nullptr ? layout->getMemoryBytes() : 0;
+        pendingStateSize = getStateSize(settings);
+        delete pending.exchange(new Slot { std::move(layout), settings });
+    }
+
+    // Any thread. Heap held by the running layout and one set but not adopted yet: frames, scratch
+    // and synthesis window. The analysis window is shared between instances, and JUCE doesn't say
+    // what its FFT holds.
+    size_t getMemoryBytes() const noexcept { return activeBytes.load() + pendingBytes.load(); }
+
+    void collectGarbage()
+    {
+        delete retired.exchange(nullptr);
+    }
+
+    void setParameters(SpectralMode newMode, float newCutoff, float thresholdDb) noexcept
+    {
+        mode = newMode;
+        cutoff = juce::jlimit(20.f, static_cast<float> (sampleRate * 0.49), newCutoff);
+        threshold = juce::Decibels::decibelsToGain(thresholdDb);
+    }
+
+    // Also finishes any crossfade, so the frames start from silence on the newest layout alone
+    void reset() noexcept
+    {
+        if (fadePosition < crossfadeLength)
+            finishCrossfade();
+
+        if (active != nullptr)
+            active->reset();
+    }
+
+    // The input is delayed by one FFT length
+    static int getLatencySamples(int order) noexcept { return 1 << order; }
+
+    // Audio thread: the layout it's running (or fading to), once adopted
+    SpectralLayoutSettings getLayout() const noexcept { return activeSettings; }
+    bool hasLayout() const noexcept { return active != nullptr; }
+    int getFFTSize() const noexcept { return active != nullptr ? active->fftSize : 0; }
+    int getHopSize() const noexcept { return active != nullptr ? active->hop : 0; }
+
+    // Audio thread, or with it stopped: finishes any crossfade and takes over a layout built since
+    // the last block straight away. process() fades to new layouts instead; prepareToPlay adopts
+    // the first one here so it runs from the first block, and restoring a snapshot does it first so
+    // the layout it's checked against is the one that will run.
+    void adoptPendingLayout() noexcept
+    {
+        if (fadePosition < crossfadeLength)
+            finishCrossfade();
+
+        // The previous swap's leftovers haven't been collected yet, keep running this one
+        if (retired.load() != nullptr)
+            return;
+
+        if (auto* next = pending.exchange(nullptr))
+        {
+            std::swap(active, next->layout);
+            std::swap(activeSettings, next->settings);
+            activeBytes = active != nullptr ? active->getMemoryBytes() : 0;
+            pendingBytes = 0;
+            activeStateSize = getStateSize(activeSettings);
+            pendingStateSize = 0;
+            retired.store(next);
+        }
+    }
+
+    void process(juce::dsp::AudioBlock<float>& block) noexcept
+    {
+        if (fadePosition >= crossfadeLength && retired.load() == nullptr)
+        {
+            if (auto* next = pending.exchange(nullptr))
+            {
+                fadingOut = std::move(active);
+                active = std::move(next->layout);
+                activeSettings = next->settings;
+                activeBytes = active != nullptr ? active->getMemoryBytes() : 0;
+                pendingBytes = 0;
+                activeStateSize = getStateSize(activeSettings);
+                pendingStateSize = 0;
+
+                // The new layout's output is the input delayed by its FFT size, so it only fades
+                // in once its first frames are through
+                fadePosition = active != nullptr ? -active->fftSize : 0;
+
+                // The slot itself goes back empty with the old layout, see finishCrossfade()
+                next->settings = {};
+                nextSlot = next;
+            }
+        }
+
+        auto numSamples = static_cast<int> (block.getNumSamples());
+        int start = 0;
+
+        // A crossfade goes in pieces the size of its buffer, whatever follows it runs in one go
+        while (start < numSamples && fadePosition < crossfadeLength)
+        {
+            auto n = juce::jmin(numSamples - start, fadeSamples);
+            auto piece = block.getSubBlock((size_t) start, (size_t) n);
+            crossfade(piece);
+            start += n;
+        }
+
+        if (start < numSamples)
+        {
+            auto rest = block.getSubBlock((size_t) start);
+            run(active.get(), rest);
+        }
+    }
+
+    // Frames in flight for DSP snapshots of a layout: per channel the hop position, the input and
+    // output windows and the smoothed gains, nothing without a layout. A crossfade in progress isn't
+    // part of it, the restored filter runs the newer layout alone.
+    static size_t getStateSize(SpectralLayoutSettings layout) noexcept
+    {
+        if (layout.order == 0)
+            return 0;
+
+        auto fftSize = (size_t) 1 << juce::jlimit(minOrder, maxOrder, layout.order);
+        return maxChannels * (sizeof(int) + (2 * fftSize + fftSize / 2 + 1) * sizeof(float));
+    }
+
+    // Any thread. Snapshot bytes of the running layout or of one set but not adopted yet, whichever
+    // is larger, so a buffer sized from it fits whichever runs by capture time.
+    size_t getStateSize() const noexcept { return juce::jmax(activeStateSize.load(), pendingStateSize.load()); }
+
+    // getStateSize(getLayout()) bytes
+    void saveState(char* dest) const noexcept
+    {
+        if (active == nullptr)
+            return;
+
+        for( auto& channel : active->channels )
+        {
+            std::memcpy(dest, &channel.hopPosition, sizeof(int));
+            dest += sizeof(int);
+
+            for( auto* frame : { &channel.input, &channel.output, &channel.gains } )
+            {
+                std::memcpy(dest, frame->data(), frame->size() * sizeof(float));
+                dest += frame->size() * sizeof(float);
+            }
+        }
+    }
+
+    // Only for a snapshot of the same layout, see getLayout()
+    void loadState(const char* source) noexcept
+    {
+        if (active == nullptr)
+            return;
+
+        for( auto& channel : active->channels )
+        {
+            std::memcpy(&channel.hopPosition, source, sizeof(int));
+            source += sizeof(int);
+
+            for( auto* frame : { &channel.input, &channel.output, &channel.gains } )
+            {
+                std::memcpy(frame->data(), source, frame->size() * sizeof(float));
+                source += frame->size() * sizeof(float);
+            }
+        }
+    }
+
+private:
+    struct Channel
+    {
+        std::vector<float> input;       // the last fftSize input samples, newest hop filling at the end
+        std::vector<float> output;      // overlap-add accumulator, the front hop is finished
+        std::vector<float> gains;       // smoothed per-bin gains
+        int hopPosition {0};
+    };
+
+    // Everything one FFT size, overlap and window needs, built in one go off the audio thread
+    struct Layout
+    {
+        Layout(const SpectralLayoutSettings& settings, double sampleRate, SharedDspResources& resources)
+            : fft(settings.order),
+              fftSize(1 << settings.order),
+              hop(fftSize / settings.overlap),
+              numBins(fftSize / 2 + 1)
+        {
+            const SharedDspResources::WindowType windowTypes[] { SharedDspResources::WindowType::hann,
+                                                                 SharedDspResources::WindowType::hamming,
+                                                                 SharedDspResources::WindowType::blackmanHarris };
+
+            window = resources.getWindow(fftSize, windowTypes[static_cast<int> (settings.window)]);
+            analysis = window->data();
+
+            // Synthesis window: the analysis one over the sum of squared windows overlapping each point
+            synthesis.assign(analysis, analysis + fftSize);
+
+            for( int j = 0; j < hop; ++j )
+            {
+                double sum = 0;
+
+                for( int n = j; n < fftSize; n += hop )
+                    sum += static_cast<double> (analysis[n]) * analysis[n];
+
+                auto scale = sum > 1.0e-6 ? static_cast<float> (1.0 / sum) : 0.f;
+
+                for( int n = j; n < fftSize; n += hop )
+                    synthesis[(size_t) n] *= scale;
+            }
+
+            // A full-scale sine on a bin comes out of the transform at half the window's sum
+            double windowSum = 0;
+            for( int n = 0; n < fftSize; ++n )
+                windowSum += analysis[n];
+
+            binAmplitude = static_cast<float> (windowSum * 0.5);
+
+            binFrequenciesSquared.resize((size_t) numBins);
+
+            for( int k = 0; k < numBins; ++k )
+            {
+                auto frequency = static_cast<float> (k * sampleRate / fftSize);
+                binFrequenciesSquared[(size_t) k] = frequency * frequency;
+            }
+
+            auto framesPerSecond = sampleRate / hop;
+            attack = static_cast<float> (1.0 - std::exp(-1.0 / (attackSeconds * framesPerSecond)));
+            release = static_cast<float> (1.0 - std::exp(-1.0 / (releaseSeconds * framesPerSecond)));
+
+            fftData.resize(2 * (size_t) fftSize);
+            power.resize((size_t) numBins);
+            targets.resize((size_t) numBins);
+            shape.resize((size_t) numBins);
+
+            for( auto& channel : channels )
+            {
+                channel.input.resize((size_t) fftSize);
+                channel.output.resize((size_t) fftSize);
+                channel.gains.resize((size_t) numBins);
+            }
+
+            reset();
+        }
+
+        void reset() noexcept
+        {
+            for( size_t c = 0; c < channels.size(); ++c )
+            {
+                auto& channel = channels[c];
+
+                std::fill(channel.input.begin(), channel.input.end(), 0.f);
+                std::fill(channel.output.begin(), channel.output.end(), 0.f);
+                std::fill(channel.gains.begin(), channel.gains.end(), 1.f);
+                channel.hopPosition = static_cast<int> (c) * hop / 2;
+            }
+        }
+
+        size_t getMemoryBytes() const noexcept
+        {
+            auto size = sizeof(*this) + (synthesis.capacity() + binFrequenciesSquared.capacity() + fftData.capacity()
+                                         + power.capacity() + targets.capacity() + shape.capacity()) * sizeof(float);
+
+            for( auto& channel : channels )
+                size += (channel.input.capacity() + channel.output.capacity() + channel.gains.capacity()) * sizeof(float);
+
+            return size;
+        }
+
+        juce::dsp::FFT fft;
+        const int fftSize, hop, numBins;
+
+        std::shared_ptr<const std::vector<float>> window;
+        const float* analysis {nullptr};
+        std::vector<float> synthesis, binFrequenciesSquared;
+        float binAmplitude {1.f};
+        float attack {1.f}, release {1.f};
+        float shapeCutoff {-1.f};
+
+        std::array<Channel, maxChannels> channels;
+        std::vector<float> fftData, power, targets, shape;
+    };
+
+    // A layout on its way to the audio thread, or the one it replaced on its way back
+    struct Slot
+    {
+        std::unique_ptr<Layout> layout;
+        SpectralLayoutSettings settings;
+    };
+
+    // No layout passes the input through
+    void run(Layout* layout, juce::dsp::AudioBlock<float>& block) noexcept
+    {
+        if (layout == nullptr)
+            return;
+
+        auto numChannels = juce::jmin(maxChannels, static_cast<int> (block.getNumChannels()));
+        auto numSamples = static_cast<int> (block.getNumSamples());
+
+        for( int c = 0; c < numChannels; ++c )
+            processChannel(*layout, layout->channels[(size_t) c], block.getChannelPointer((size_t) c), numSamples);
+    }
+
+    // At most fadeSamples: the old layout on a copy, the new one in place, then the mix
+    void crossfade(juce::dsp::AudioBlock<float>& block) noexcept
+    {
+        auto numChannels = juce::jmin(maxChannels, static_cast<int> (block.getNumChannels()));
+        auto numSamples = static_cast<int> (block.getNumSamples());
+        jassert (numSamples <= fadeSamples);
+
+        juce::dsp::AudioBlock<float> oldBlock (fadeBuffer.data(), (size_t) numChannels, (size_t) numSamples);
+        oldBlock.copyFrom(block.getSubsetChannelBlock(0, (size_t) numChannels));
+
+        run(fadingOut.get(), oldBlock);
+        run(active.get(), block);
+
+        auto step = 1.f / static_cast<float> (crossfadeLength);
+
+        for( int c = 0; c < numChannels; ++c )
+        {
+            auto* newSamples = block.getChannelPointer((size_t) c);
+            auto* oldSamples = oldBlock.getChannelPointer((size_t) c);
+            auto gain = static_cast<float> (fadePosition) * step;
+
+            for( int i = 0; i < numSamples; ++i )
+            {
+                auto g = juce::jlimit(0.f, 1.f, gain);
+                newSamples[i] = oldSamples[i] + g * (newSamples[i] - oldSamples[i]);
+                gain += step;
+            }
+        }
+
+        fadePosition += numSamples;
+
+        if (fadePosition >= crossfadeLength)
+            finishCrossfade();
+    }
+
+    void abandonCrossfade()
+    {
+        delete nextSlot;
+        nextSlot = nullptr;
+        fadingOut.reset();
+        fadePosition = crossfadeLength;
+    }
+
+    void finishCrossfade() noexcept
+    {
+        // Hand the old layout back in the slot the new one arrived in, freed on the next setLayout()
+        jassert (nextSlot != nullptr && retired.load() == nullptr);
+        nextSlot->layout = std::move(fadingOut);
+        retired.store(nextSlot);
+        nextSlot = nullptr;
+        fadePosition = crossfadeLength;
+    }
+
+    void processChannel(Layout& layout, Channel& channel, float* samples, int numSamples) noexcept
+    {
+        const auto fftSize = layout.fftSize, hop = layout.hop;
+
+        for( int done = 0; done < numSamples; )
+        {
+            auto n = juce::jmin(numSamples - done, hop - channel.hopPosition);
+            auto* io = samples + done;
+
+            juce::FloatVectorOperations::copy(channel.input.data() + fftSize - hop + channel.hopPosition, io, n);
+            juce::FloatVectorOperations::copy(io, channel.output.data() + channel.hopPosition, n);
+
+            channel.hopPosition += n;
+            done += n;
+
+            if (channel.hopPosition == hop)
+            {
+                processFrame(layout, channel);
+                channel.hopPosition = 0;
+            }
+        }
+    }
+
+    void processFrame(Layout& layout, Channel& channel) noexcept
+    {
+        const auto fftSize = layout.fftSize, hop = layout.hop, numBins = layout.numBins;
+        auto* fftData = layout.fftData.data();
+        auto* power = layout.power.data();
+        auto* targets = layout.targets.data();
+
+        juce::FloatVectorOperations::multiply(fftData, channel.input.data(), layout.analysis, fftSize);
+        juce::FloatVectorOperations::clear(fftData + fftSize, fftSize);
+        layout.fft.performRealOnlyForwardTransform(fftData, true);
+
+        for( int k = 0; k < numBins; ++k )
+            power[k] = fftData[2 * k] * fftData[2 * k] + fftData[2 * k + 1] * fftData[2 * k + 1];
+
+        // Gate: 1 above the threshold, the floor below. Branch-free so it vectorises.
+        const float thresholdPower = (threshold * layout.binAmplitude) * (threshold * layout.binAmplitude);
+
+        for( int k = 0; k < numBins; ++k )
+            targets[k] = power[k] >= thresholdPower ? 1.f : floorGain;
+
+        if (mode == SpectralMode::DynamicLowPass)
+        {
+            updateShape(layout);
+            juce::FloatVectorOperations::max(targets, targets, layout.shape.data(), numBins);
+        }
+
+        auto* gains = channel.gains.data();
+        const float up = layout.attack, down = layout.release;
+
+        for( int k = 0; k < numBins; ++k )
+        {
+            auto difference = targets[k] - gains[k];
+            gains[k] += (difference > 0 ? up : down) * difference;
+        }
+
+        for( int k = 0; k < numBins; ++k )
+        {
+            fftData[2 * k] *= gains[k];
+            fftData[2 * k + 1] *= gains[k];
+        }
+
+        layout.fft.performRealOnlyInverseTransform(fftData);
+
+        // Slide both windows on by a hop, then add the new frame
+        auto* input = channel.input.data();
+        auto* output = channel.output.data();
+
+        std::copy(input + hop, input + fftSize, input);
+        std::copy(output + hop, output + fftSize, output);
+        juce::FloatVectorOperations::clear(output + fftSize - hop, hop);
+        juce::FloatVectorOperations::addWithMultiply(output, fftData, layout.synthesis.data(), fftSize);
+    }
+
+    // Fourth-order Butterworth magnitude, 1 / sqrt(1 + (f / fc)^8), only when the cutoff moved
+    void updateShape(Layout& layout) noexcept
+    {
+        if (cutoff == layout.shapeCutoff)
+            return;
+
+        layout.shapeCutoff = cutoff;
+        const float scale = 1.f / (cutoff * cutoff);
+
+        for( int k = 0; k < layout.numBins; ++k )
+        {
+            auto r2 = layout.binFrequenciesSquared[(size_t) k] * scale;
+            auto r4 = r2 * r2;
+            layout.shape[(size_t) k] = 1.f / std::sqrt(1.f + r4 * r4);
+        }
+    }
+
+    SharedDspResources* resources {nullptr};
+    double sampleRate {44100};
+
+    std::unique_ptr<Layout> active, fadingOut;
+    SpectralLayoutSettings activeSettings;
+    Slot* nextSlot {nullptr};
+
+    std::atomic<Slot*> pending {nullptr};
+    std::atomic<Slot*> retired {nullptr};
+    std::atomic<size_t> activeBytes {0}, pendingBytes {0};
+    std::atomic<size_t> activeStateSize {0}, pendingStateSize {0};
+
+    // Old layout's output during a crossfade, in the processor's DspArena
+    std::array<float*, maxChannels> fadeBuffer {};
+    int fadeSamples {0};
+    int crossfadeLength {1};
+    int fadePosition {1};
+
+    SpectralMode mode {SpectralMode::DynamicLowPass};
+    float cutoff {1000.f};
+    float threshold {0.003f};
+
+    JUCE_DECLARE_NON_COPYABLE(SpectralFilter)
+};
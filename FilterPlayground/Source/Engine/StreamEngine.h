@@ -0,0 +1,313 @@
+/*
+  ==============================================================================
+
+    StreamEngine.h
+    Created: 9 Oct 2022 10:42:31am
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "CustomFilter.h"
+#include "FilterKernels.h"
+#include "OnePoleTPT.h"
+#include "SharedResources.h"
+#include "WorkerPool.h"
+
+// One block of audio handed to the engine. Owned by the caller and processed in place;
+// keep it (and the channel memory) alive until isDone() returns true.
+struct StreamBlock
+{
+    float* const* channels {nullptr};
+    int numSamples {0};
+
+    bool isDone() const noexcept { return done.load(std::memory_order_acquire); }
+
+private:
+    friend class StreamEngine;
+    std::atomic<bool> done {true};
+    juce::int64 submitTicks {0};
+};
+
+// What getStats() publishes for one stream, everything since the stream was added
+struct StreamStats
+{
+    juce::int64 blocks {0};
+    juce::int64 samples {0};
+    juce::int64 rejectedBlocks {0};   // submitted while the stream's queue was full
+
+    double meanLatencyMs {0};         // submit -> done
+    double maxLatencyMs {0};
+    double realtimeFactor {0};        // seconds of audio filtered per second spent filtering
+};
+
+// Headless host for many lightweight filter streams (server-side voice channels and the like),
+// no juce::AudioProcessor involved. Each stream is a one-pole low-pass per channel designed
+// through CustomFilter, plus a small queue of pending blocks. A stream is a WorkerJob on the
+// engine's own work-stealing pool, so its blocks run in submission order, never on two workers
+// at once, and streams with nothing queued cost nothing.
+//
+// Threading: addStream/removeStream from one control thread; submit() from one producer per
+// stream; setCutoff() and getStats() from anywhere.
+class StreamEngine
+{
+public:
+    struct Options
+    {
+        double sampleRate {48000};
+        int numChannels {1};
+        int maxStreams {1024};
+        int queueDepth {4};                             // pending blocks per stream
+        int numWorkers {juce::SystemStats::getNumCpus()};
+        bool pinWorkers {true};
+    };
+
+    // Called on the worker right after a block finishes, keep it short
+    struct Listener
+    {
+        virtual ~Listener() = default;
+        virtual void blockProcessed(int streamId, StreamBlock& block) = 0;
+    };
+
+    explicit StreamEngine(const Options& engineOptions)
+        : options(engineOptions),
+          workers(juce::jmax(1, options.numWorkers), options.pinWorkers)
+    {
+        // Every active stream can sit in a worker queue at most once
+        jassert (options.maxStreams <= workers.getNumWorkers() * WorkerPool::queueCapacity);
+
+        filter.prepare(*sharedResources, options.sampleRate);
+        kernels = &FilterKernelDispatch::select();
+
+        for( int i = 0; i < options.maxStreams; ++i )
+            streams.push_back(std::make_unique<Stream>(*this, i));
+    }
+
+    ~StreamEngine()
+    {
+        for( auto& stream : streams )
+            workers.cancelAndWait(*stream);
+    }
+
+    const Options& getOptions() const noexcept { return options; }
+    int getNumWorkers() const noexcept { return workers.getNumWorkers(); }
+    const FilterKernels& getKernels() const noexcept { return *kernels; }
+
+    void setListener(Listener* newListener) noexcept { listener.store(newListener); }
+
+    // Returns the new stream's id, or -1 when maxStreams are already in use
+    int addStream(float cutoff)
+    {
+        for( auto& stream : streams )
+        {
+            if (stream->active.load())
+                continue;
+
+            stream->reset(cutoff);
+            stream->active.store(true, std::memory_order_release);
+            return stream->id;
+        }
+
+        return -1;
+    }
+
+    // Blocks still queued for the stream are dropped, their isDone() stays false
+    void removeStream(int id)
+    {
+        if (! isValid(id))
+            return;
+
+        auto& stream = *streams[(size_t) id];
+        stream.active.store(false, std::memory_order_release);
+        workers.cancelAndWait(stream);
+    }
+
+    void setCutoff(int id, float cutoff) noexcept
+    {
+        if (isValid(id))
+            streams[(size_t) id]->cutoff.store(cutoff, std::memory_order_relaxed);
+    }
+
+    // Queues the block and wakes a worker. Never blocks or allocates; returns false if the
+    // stream doesn't exist or already has queueDepth blocks waiting.
+    bool submit(int id, StreamBlock& block) noexcept
+    {
+        if (! isValid(id) || ! streams[(size_t) id]->active.load(std::memory_order_acquire))
+            return false;
+
+        jassert (block.numSamples > 0 && block.channels != nullptr);
+
+        auto& stream = *streams[(size_t) id];
+        int start1, size1, start2, size2;
+        stream.fifo.prepareToWrite(1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+        {
+            stream.rejected.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        block.done.store(false, std::memory_order_relaxed);
+        block.submitTicks = juce::Time::getHighResolutionTicks();
+        stream.pending[(size_t) (size1 > 0 ? start1 : start2)] = &block;
+        stream.fifo.finishedWrite(1);
+
+        workers.submit(stream, WorkerJob::Lane::Normal);
+        return true;
+    }
+
+    StreamStats getStats(int id) const noexcept
+    {
+        StreamStats stats;
+
+        if (! isValid(id))
+            return stats;
+
+        auto& stream = *streams[(size_t) id];
+        auto ticksPerMs = static_cast<double> (juce::Time::getHighResolutionTicksPerSecond()) / 1000.0;
+        auto processTicks = static_cast<double> (stream.processTicks.load(std::memory_order_relaxed));
+
+        stats.blocks = stream.blocks.load(std::memory_order_relaxed);
+        stats.samples = stream.samples.load(std::memory_order_relaxed);
+        stats.rejectedBlocks = stream.rejected.load(std::memory_order_relaxed);
+        stats.meanLatencyMs = stats.blocks > 0 ? static_cast<double> (stream.latencyTicks.load(std::memory_order_relaxed)) / ticksPerMs / static_cast<double> (stats.blocks) : 0.0;
+        stats.maxLatencyMs = static_cast<double> (stream.maxLatencyTicks.load(std::memory_order_relaxed)) / ticksPerMs;
+        stats.realtimeFactor = processTicks > 0 ? (static_cast<double> (stats.samples) / options.sampleRate) / (processTicks / ticksPerMs / 1000.0) : 0.0;
+
+        return stats;
+    }
+
+private:
+    bool isValid(int id) const noexcept { return id >= 0 && id < (int) streams.size(); }
+
+    struct Stream : public WorkerJob
+    {
+        Stream(StreamEngine& e, int streamId)
+            : engine(e),
+              id(streamId),
+              fifo(e.options.queueDepth + 1),
+              pending((size_t) (e.options.queueDepth + 1), nullptr),
+              states((size_t) e.options.numChannels)
+        {
+        }
+
+        void reset(float newCutoff) noexcept
+        {
+            fifo.reset();
+            cutoff.store(newCutoff);
+            designedCutoff = -1.f;
+
+            for( auto& s : states )
+                s = 0;
+
+            blocks = 0;
+            samples = 0;
+            rejected = 0;
+            latencyTicks = 0;
+            maxLatencyTicks = 0;
+            processTicks = 0;
+        }
+
+        // Drains everything queued so far, oldest first
+        void run() override
+        {
+            while (active.load(std::memory_order_acquire) && ! isCancelled())
+            {
+                int start1, size1, start2, size2;
+                fifo.prepareToRead(1, start1, size1, start2, size2);
+
+                if (size1 + size2 == 0)
+                    return;
+
+                auto& block = *pending[(size_t) (size1 > 0 ? start1 : start2)];
+
+                auto start = juce::Time::getHighResolutionTicks();
+                process(block);
+                auto end = juce::Time::getHighResolutionTicks();
+
+                auto latency = end - block.submitTicks;
+
+                blocks.fetch_add(1, std::memory_order_relaxed);
+                samples.fetch_add(block.numSamples, std::memory_order_relaxed);
+                latencyTicks.fetch_add(latency, std::memory_order_relaxed);
+                processTicks.fetch_add(end - start, std::memory_order_relaxed);
+
+                if (latency > maxLatencyTicks.load(std::memory_order_relaxed))
+                    maxLatencyTicks.store(latency, std::memory_order_relaxed);
+
+                // Slot stays claimed until the block is finished, so the producer can't reuse it early
+                fifo.finishedRead(1);
+                block.done.store(true, std::memory_order_release);
+
+                if (auto* l = engine.listener.load())
+                    l->blockProcessed(id, block);
+            }
+        }
+
+        void process(StreamBlock& block) noexcept
+        {
+            auto newCutoff = cutoff.load(std::memory_order_relaxed);
+
+            // New cutoffs ramp over the block like OnePoleLowPass::setTargetAlpha
+            if (newCutoff != designedCutoff)
+            {
+                auto maxCutoff = juce::jmin(SharedDspResources::maxTableFrequency, static_cast<float> (engine.options.sampleRate * 0.49));
+                auto newAlpha = engine.filter.getAlpha(engine.options.sampleRate, juce::jlimit(20.f, maxCutoff, newCutoff));
+                auto startAlpha = designedCutoff < 0 ? newAlpha : alpha;
+
+                for( int ch = 0; ch < engine.options.numChannels; ++ch )
+                    states[(size_t) ch] = engine.kernels->processRamp(states[(size_t) ch], startAlpha, newAlpha,
+                                                                      block.channels[ch], block.channels[ch], block.numSamples);
+
+                alpha = newAlpha;
+                designedCutoff = newCutoff;
+            }
+            else
+            {
+                for( int ch = 0; ch < engine.options.numChannels; ++ch )
+                    states[(size_t) ch] = engine.kernels->process(states[(size_t) ch], alpha,
+                                                                  block.channels[ch], block.channels[ch], block.numSamples);
+            }
+
+            for( auto& s : states )
+                if (std::abs(s) < 1.0e-15f)
+                    s = 0;
+        }
+
+        StreamEngine& engine;
+        const int id;
+
+        std::atomic<bool> active {false};
+        std::atomic<float> cutoff {1000.f};
+
+        juce::AbstractFifo fifo;
+        std::vector<StreamBlock*> pending;
+
+        // Only touched by whichever worker is running the stream
+        std::vector<float> states;
+        float alpha {1.f};
+        float designedCutoff {-1.f};
+
+        std::atomic<juce::int64> blocks {0}, samples {0}, rejected {0};
+        std::atomic<juce::int64> latencyTicks {0}, maxLatencyTicks {0}, processTicks {0};
+    };
+
+    const Options options;
+
+    juce::SharedResourcePointer<SharedDspResources> sharedResources;
+    CustomFilter filter;
+    const FilterKernels* kernels {nullptr};
+
+    std::vector<std::unique_ptr<Stream>> streams;
+    std::atomic<Listener*> listener {nullptr};
+
+    // Declared last so its workers stop before the streams they might be running go away
+    WorkerPool workers;
+
+    JUCE_DECLARE_NON_COPYABLE(StreamEngine)
+};
@@ -0,0 +1,192 @@
+/*
+  ==============================================================================
+
+    Trace.h
+    Created: 2 Oct 2022 1:17:55pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <cstdio>
+
+// Timeline tracing of processBlock stages and background jobs, exported as Chrome trace JSON
+// (opens in chrome://tracing and ui.perfetto.dev).
+//
+// Build with FILTERPLAYGROUND_TRACE=1 (Projucer: Preprocessor Definitions) to compile the markers
+// in; otherwise FP_TRACE_SCOPE expands to nothing. When compiled in, a marker costs two tick reads
+// and one store into the calling thread's own ring, no locks and no allocation, and recording can
+// still be switched off at runtime with TraceRecorder::setEnabled().
+#ifndef FILTERPLAYGROUND_TRACE
+ #define FILTERPLAYGROUND_TRACE 0
+#endif
+
+#if FILTERPLAYGROUND_TRACE
+ #define FP_TRACE_SCOPE(name) const TraceScope JUCE_JOIN_MACRO(traceScope_, __LINE__) (name)
+#else
+ #define FP_TRACE_SCOPE(name)
+#endif
+
+class TraceRecorder
+{
+public:
+    static constexpr int maxThreads = 64;
+    static constexpr int eventsPerThread = 1 << 12;
+
+    struct Event
+    {
+        const char* name;   // string literal, never copied
+        juce::int64 start;
+        juce::int64 end;
+    };
+
+    // One writer (its thread), readers only ever copy out of it
+    struct ThreadBuffer
+    {
+        void record(const char* name, juce::int64 start, juce::int64 end) noexcept
+        {
+            auto index = written.load(std::memory_order_relaxed);
+            events[(size_t) (index & (eventsPerThread - 1))] = { name, start, end };
+            written.store(index + 1, std::memory_order_release);
+        }
+
+        std::array<Event, eventsPerThread> events;
+        std::atomic<juce::uint64> written {0};
+        char threadName[32] {};
+    };
+
+    static void setEnabled(bool shouldBeEnabled) noexcept { enabled.store(shouldBeEnabled, std::memory_order_relaxed); }
+    static bool isEnabled() noexcept { return enabled.load(std::memory_order_relaxed); }
+
+    // Buffers are claimed from a static pool the first time a thread records, so even the
+    // audio thread's first marker doesn't allocate. Threads past maxThreads aren't recorded.
+    static ThreadBuffer* getBufferForThisThread() noexcept
+    {
+        thread_local ThreadBuffer* buffer = nullptr;
+
+        if (buffer == nullptr)
+        {
+            auto index = numThreads.fetch_add(1, std::memory_order_relaxed);
+
+            if (index >= maxThreads)
+                return nullptr;
+
+            buffer = &getBuffers()[(size_t) index];
+
+            if (auto* thread = juce::Thread::getCurrentThread())
+                thread->getThreadName().copyToUTF8(buffer->threadName, sizeof(buffer->threadName));
+            else
+                std::snprintf(buffer->threadName, sizeof(buffer->threadName), "host thread %d", index);
+        }
+
+        return buffer;
+    }
+
+    // Message thread or a tool, any time. Writes everything still in the rings as complete ("X")
+    // events plus thread names; events overwritten while copying are dropped, not torn.
+    static bool exportChromeTrace(juce::OutputStream& out)
+    {
+        auto ticksPerMicrosecond = static_cast<double> (juce::Time::getHighResolutionTicksPerSecond()) / 1.0e6;
+        auto numBuffers = juce::jmin(maxThreads, numThreads.load());
+        bool first = true;
+
+        auto separator = [&first, &out]
+        {
+            if (! first)
+                out << ",\n";
+
+            first = false;
+        };
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+        std::vector<Event> copy;
+
+        for( int tid = 0; tid < numBuffers; ++tid )
+        {
+            auto& buffer = getBuffers()[(size_t) tid];
+
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+                << ",\"args\":{\"name\":\"" << juce::String(buffer.threadName) << "\"}}";
+
+            auto endIndex = buffer.written.load(std::memory_order_acquire);
+            auto beginIndex = endIndex > (juce::uint64) eventsPerThread ? endIndex - (juce::uint64) eventsPerThread : 0;
+
+            copy.clear();
+            for( auto i = beginIndex; i < endIndex; ++i )
+                copy.push_back(buffer.events[(size_t) (i & (eventsPerThread - 1))]);
+
+            // Anything the writer lapped while we copied is unreliable, and so is the slot it may be
+            // halfway through: event lappedUpTo goes where lappedUpTo - eventsPerThread was
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto lappedUpTo = buffer.written.load(std::memory_order_relaxed);
+            auto firstValid = lappedUpTo >= (juce::uint64) eventsPerThread ? lappedUpTo - (juce::uint64) eventsPerThread + 1 : 0;
+
+            for( auto i = beginIndex; i < endIndex; ++i )
+            {
+                if (i < firstValid)
+                    continue;
+
+                auto& e = copy[(size_t) (i - beginIndex)];
+
+                separator();
+                out << "{\"name\":\"" << juce::String(e.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                    << ",\"ts\":" << juce::String(static_cast<double> (e.start) / ticksPerMicrosecond, 3)
+                    << ",\"dur\":" << juce::String(static_cast<double> (e.end - e.start) / ticksPerMicrosecond, 3) << "}";
+            }
+        }
+
+        out << "\n]}\n";
+        out.flush();
+        return true;
+    }
+
+    static bool exportChromeTrace(const juce::File& file)
+    {
+        file.deleteFile();
+        juce::FileOutputStream out (file);
+
+        return out.openedOk() && exportChromeTrace(out);
+    }
+
+private:
+    // Zero-initialised static storage, the pages are only touched by threads that record
+    static std::array<ThreadBuffer, maxThreads>& getBuffers() noexcept
+    {
+        static std::array<ThreadBuffer, maxThreads> buffers;
+        return buffers;
+    }
+
+    static inline std::atomic<int> numThreads {0};
+    static inline std::atomic<bool> enabled {true};
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* eventName) noexcept
+        : name(eventName),
+          start(TraceRecorder::isEnabled() ? juce::Time::getHighResolutionTicks() : 0)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (start == 0)
+            return;
+
+        if (auto* buffer = TraceRecorder::getBufferForThisThread())
+            buffer->record(name, start, juce::Time::getHighResolutionTicks());
+    }
+
+private:
+    const char* name;
+    juce::int64 start;
+
+    JUCE_DECLARE_NON_COPYABLE(TraceScope)
+};
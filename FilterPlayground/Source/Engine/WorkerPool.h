@@ -0,0 +1,344 @@
+/*
+  ==============================================================================
+
+    WorkerPool.h
+    Created: 21 Aug 2022 4:37:52pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Trace.h"
+
+#if JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#elif JUCE_LINUX || JUCE_BSD || JUCE_ANDROID
+ #include <semaphore.h>
+#endif
+
+class WorkerPool;
+
+// A unit of non-real-time work (coefficient redesign, FIR generation, analyser FFTs...).
+// Jobs are owned by whoever submits them and are meant to be reused: submitting a job that
+// is still waiting in a queue doesn't queue it twice, it just runs once and should read its
+// inputs when run() is called, so a burst of cutoff changes collapses into a single redesign
+// and stale requests never get computed.
+class WorkerJob
+{
+public:
+    enum class Lane
+    {
+        High,   // results the audio thread is waiting on
+        Normal,
+        Low     // analysis/visualisation, fine to lag behind
+    };
+
+    virtual ~WorkerJob() = default;
+    virtual void run() = 0;
+
+    bool isCancelled() const noexcept { return cancelled.load(std::memory_order_relaxed); }
+
+private:
+    friend class WorkerPool;
+    std::atomic<bool> queued {false};
+    std::atomic<bool> running {false};
+    std::atomic<bool> cancelled {false};
+};
+
+// Counting semaphore the workers sleep on. Posting is an atomic increment plus, only when a
+// worker is actually asleep, a kernel wake-up: no user-space mutex, so the audio thread can post
+// without risking priority inversion (juce::WaitableEvent::signal() locks a std::mutex).
+class WakeUpSemaphore
+{
+public:
+   #if JUCE_MAC || JUCE_IOS
+    WakeUpSemaphore() : semaphore (dispatch_semaphore_create(0)) {}
+    ~WakeUpSemaphore() { dispatch_release(semaphore); }
+
+    void post() noexcept { dispatch_semaphore_signal(semaphore); }
+    void wait() noexcept { dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER); }
+
+   private:
+    dispatch_semaphore_t semaphore;
+   #elif JUCE_LINUX || JUCE_BSD || JUCE_ANDROID
+    WakeUpSemaphore() { sem_init(&semaphore, 0, 0); }
+    ~WakeUpSemaphore() { sem_destroy(&semaphore); }
+
+    void post() noexcept { sem_post(&semaphore); }
+    void wait() noexcept { while (sem_wait(&semaphore) != 0) {} }
+
+   private:
+    sem_t semaphore;
+   #else
+    // No exporter targets anything else yet
+    WakeUpSemaphore() = default;
+
+    void post() noexcept { event.signal(); }
+    void wait() noexcept { event.wait(); }
+
+   private:
+    juce::WaitableEvent event;
+   #endif
+
+    JUCE_DECLARE_NON_COPYABLE(WakeUpSemaphore)
+};
+
+// Small pool of worker threads shared by every plugin instance in the process,
+// grab it with juce::SharedResourcePointer<WorkerPool>.
+// Each worker owns one bounded queue per lane; submissions are spread round-robin and idle
+// workers steal from the others, always draining higher lanes first.
+class WorkerPool
+{
+public:
+    static constexpr int queueCapacity = 1024;
+
+    WorkerPool()
+        : WorkerPool(juce::jlimit(1, 8, juce::SystemStats::getNumCpus() - 2), false)
+    {
+    }
+
+    // For hosts that own their pool (the headless stream engine): pinned workers each stay on
+    // core (index % numCpus), which keeps a stream's filter state warm in that core's cache.
+    WorkerPool(int numWorkers, bool pinToCores)
+    {
+        jassert (numWorkers > 0);
+
+        for( int i = 0; i < numWorkers; ++i )
+            workers.push_back(std::make_unique<Worker>(*this, i));
+
+        auto numCpus = juce::jmin(32, juce::SystemStats::getNumCpus());
+
+        for( auto& w : workers )
+        {
+            if (pinToCores && numCpus > 0)
+                w->setAffinityMask(1u << (juce::uint32) (w->workerIndex % numCpus));
+
+            w->startThread();
+        }
+    }
+
+    ~WorkerPool()
+    {
+        for( auto& w : workers )
+            w->signalThreadShouldExit();
+
+        for( auto& w : workers )
+        {
+            w->wakeUp.post();
+            w->stopThread(2000);
+        }
+    }
+
+    int getNumWorkers() const noexcept { return (int) workers.size(); }
+
+    // Never allocates, holds a spin lock only for a pointer push and wakes the worker with a
+    // semaphore post, so it's fine to call from the audio thread. Returns false if the job was
+    // already queued (it will still run).
+    bool submit(WorkerJob& job, WorkerJob::Lane lane = WorkerJob::Lane::Normal)
+    {
+        job.cancelled.store(false, std::memory_order_relaxed);
+
+        if (job.queued.exchange(true, std::memory_order_acq_rel))
+            return false;
+
+        auto first = (size_t) nextWorker.fetch_add(1, std::memory_order_relaxed);
+
+        for( size_t i = 0; i < workers.size(); ++i )
+        {
+            auto& w = *workers[(first + i) % workers.size()];
+
+            if (w.queues[(size_t) lane].push(&job))
+            {
+                w.wakeUp.post();
+                return true;
+            }
+        }
+
+        // Every queue is full, which means something is submitting without bound
+        jassertfalse;
+        job.queued.store(false, std::memory_order_release);
+        return false;
+    }
+
+    // Marks the job so a queued run is skipped. A run that already started finishes normally.
+    void cancel(WorkerJob& job) noexcept
+    {
+        job.cancelled.store(true, std::memory_order_relaxed);
+    }
+
+    // Cancels and blocks until no worker holds the job any more. Call before destroying a job
+    // or touching the state it reads, never from the audio thread.
+    void cancelAndWait(WorkerJob& job)
+    {
+        cancel(job);
+
+        while (job.queued.load(std::memory_order_acquire) || job.running.load(std::memory_order_acquire))
+            juce::Thread::yield();
+    }
+
+    // Runs task(i) for every i in [0, numTasks) on the workers and the calling thread,
+    // returning once all of them are done. Allocates and blocks: offline rendering and tools only.
+    void parallelFor(int numTasks, const std::function<void(int)>& task)
+    {
+        struct Helper : public WorkerJob
+        {
+            Helper(std::atomic<int>& n, int total, const std::function<void(int)>& t)
+                : next(n), numTasks(total), task(t) {}
+
+            void run() override
+            {
+                for( int i = next++; i < numTasks; i = next++ )
+                {
+                    FP_TRACE_SCOPE("parallelFor task");
+                    task(i);
+                }
+            }
+
+            std::atomic<int>& next;
+            const int numTasks;
+            const std::function<void(int)>& task;
+        };
+
+        std::atomic<int> next {0};
+        std::vector<std::unique_ptr<Helper>> helpers;
+
+        auto numHelpers = juce::jmin(getNumWorkers(), numTasks - 1);
+        for( int i = 0; i < numHelpers; ++i )
+        {
+            helpers.push_back(std::make_unique<Helper>(next, numTasks, task));
+            submit(*helpers.back(), WorkerJob::Lane::Normal);
+        }
+
+        Helper(next, numTasks, task).run();
+
+        // Every index has been claimed, helpers that haven't started yet have nothing left to do
+        for( auto& h : helpers )
+            cancelAndWait(*h);
+    }
+
+private:
+    // Bounded ring of job pointers. Owner pops the oldest, thieves do the same:
+    // jobs are independent so FIFO order within a lane is all we need.
+    struct JobQueue
+    {
+        bool push(WorkerJob* job) noexcept
+        {
+            const juce::SpinLock::ScopedLockType sl (lock);
+
+            if (size == queueCapacity)
+                return false;
+
+            jobs[(size_t) ((head + size) % queueCapacity)] = job;
+            ++size;
+            return true;
+        }
+
+        WorkerJob* pop() noexcept
+        {
+            if (size == 0)
+                return nullptr;
+
+            const juce::SpinLock::ScopedLockType sl (lock);
+
+            if (size == 0)
+                return nullptr;
+
+            auto* job = jobs[(size_t) head];
+            head = (head + 1) % queueCapacity;
+            --size;
+            return job;
+        }
+
+        juce::SpinLock lock;
+        std::array<WorkerJob*, queueCapacity> jobs {};
+        int head = 0;
+        std::atomic<int> size {0};
+    };
+
+    static constexpr int numLanes = 3;
+
+    struct Worker : public juce::Thread
+    {
+        Worker(WorkerPool& p, int index)
+            : juce::Thread("FilterPlayground worker " + juce::String(index)), pool(p), workerIndex(index)
+        {
+        }
+
+        void run() override
+        {
+            while (! threadShouldExit())
+            {
+                size_t lane = 0;
+
+                // Every submission posts once, so a job pushed after findJob() came up empty
+                // still wakes this worker straight away
+                if (auto* job = pool.findJob(workerIndex, lane))
+                    pool.runJob(*job, workerIndex, lane);
+                else
+                    wakeUp.wait();
+            }
+        }
+
+        WorkerPool& pool;
+        const int workerIndex;
+        std::array<JobQueue, numLanes> queues;
+        WakeUpSemaphore wakeUp;
+    };
+
+    WorkerJob* findJob(int workerIndex, size_t& lane)
+    {
+        for( lane = 0; lane < (size_t) numLanes; ++lane )
+        {
+            if (auto* job = workers[(size_t) workerIndex]->queues[lane].pop())
+                return job;
+
+            for( size_t i = 1; i < workers.size(); ++i )
+            {
+                auto victim = ((size_t) workerIndex + i) % workers.size();
+
+                if (auto* job = workers[victim]->queues[lane].pop())
+                    return job;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void runJob(WorkerJob& job, int workerIndex, size_t lane)
+    {
+        // A job never runs on two workers at once: if it got resubmitted and stolen while
+        // its previous run is still going, put it back and let that run finish first.
+        if (job.running.exchange(true, std::memory_order_acq_rel))
+        {
+            if (! workers[(size_t) workerIndex]->queues[lane].push(&job))
+                job.queued.store(false, std::memory_order_release);
+
+            juce::Thread::yield();
+            return;
+        }
+
+        // Clear the queued flag before running so a submission that arrives mid-run
+        // schedules a fresh run with the newer inputs.
+        job.queued.store(false, std::memory_order_release);
+
+        if (! job.isCancelled())
+        {
+            FP_TRACE_SCOPE("worker job");
+            job.run();
+        }
+
+        job.running.store(false, std::memory_order_release);
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int> nextWorker {0};
+
+    JUCE_DECLARE_NON_COPYABLE(WorkerPool)
+};
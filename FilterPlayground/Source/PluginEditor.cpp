@@ -1,36 +1,78 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin editor.
-
-  ==============================================================================
-*/
-
-#include "PluginProcessor.h"
-#include "PluginEditor.h"
-
-//==============================================================================
-FilterPlaygroundAudioProcessorEditor::FilterPlaygroundAudioProcessorEditor (FilterPlaygroundAudioProcessor& p)
-    : AudioProcessorEditor (&p), audioProcessor (p)
-{
-    // Make sure that before the constructor has finished, you've set the
-    // editor's size to whatever you need it to be.
-    setSize (400, 300);
-}
-
-FilterPlaygroundAudioProcessorEditor::~FilterPlaygroundAudioProcessorEditor()
-{
-}
-
-//==============================================================================
-void FilterPlaygroundAudioProcessorEditor::paint (juce::Graphics& g)
-{
-    // (Our component is opaque, so we must completely fill the background with a solid colour)
-    g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
-}
-
-void FilterPlaygroundAudioProcessorEditor::resized()
-{
-    // This is generally where you'll want to lay out the positions of any
-    // subcomponents in your editor..
-}
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin editor.
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+
+//==============================================================================
+FilterPlaygroundAudioProcessorEditor::FilterPlaygroundAudioProcessorEditor (FilterPlaygroundAudioProcessor& p)
+    : AudioProcessorEditor (&p), audioProcessor (p), parameterEditor (p)
+{
+    addAndMakeVisible(parameterEditor);
+    
+    // Make sure that before the constructor has finished, you've set the
+    // editor's size to whatever you need it to be.
+    setSize (juce::jmax(400, parameterEditor.getWidth()), parameterEditor.getHeight() + statusHeight);
+    
+    startTimerHz(30);
+}
+
+FilterPlaygroundAudioProcessorEditor::~FilterPlaygroundAudioProcessorEditor()
+{
+}
+
+//==============================================================================
+void FilterPlaygroundAudioProcessorEditor::paint (juce::Graphics& g)
+{
+    // (Our component is opaque, so we must completely fill the background with a solid colour)
+    g.fillAll (getLookAndFeel().findColour (juce::ResizableWindow::backgroundColourId));
+    
+    auto toDb = [](float gain) { return juce::String(juce::Decibels::gainToDecibels(gain, -100.f), 1); };
+    
+    auto describe = [&](const juce::String& name, const LevelReadings& levels)
+    {
+        return name + "  peak " + toDb(levels.peak[0]) + " / " + toDb(levels.peak[1])
+             + "  rms " + toDb(levels.rms[0]) + " / " + toDb(levels.rms[1])
+             + "  true peak " + toDb(levels.truePeak)
+             + "  " + juce::String(levels.shortTermLufs, 1) + " LUFS";
+    };
+    
+    g.setColour(juce::Colours::white);
+    g.setFont(13.f);
+    
+    auto area = getLocalBounds().removeFromBottom(statusHeight).reduced(10);
+    g.drawFittedText(describe("In ", inputLevels), area.removeFromTop(20), juce::Justification::centredLeft, 1);
+    g.drawFittedText(describe("Out", outputLevels), area.removeFromTop(20), juce::Justification::centredLeft, 1);
+    
+    const char* tierNames[] = { "Full", "Reduced", "Minimum" };
+    auto percent = [](double load) { return juce::String(load * 100.0, 1) + "%"; };
+    
+    g.drawFittedText("Quality " + juce::String(tierNames[static_cast<int>(qualityTier)])
+                     + "  load " + percent(processingLoad) + ", session " + percent(sessionLoad)
+                     + "  steps down with the session above " + percent(qualityPolicy.stepDownLoad) + " for " + juce::String(qualityPolicy.blocksBeforeStepDown) + " blocks,"
+                     + " up below " + percent(qualityPolicy.stepUpLoad) + " for " + juce::String(qualityPolicy.blocksBeforeStepUp) + " blocks",
+                     area, juce::Justification::centredLeft, 1);
+}
+
+void FilterPlaygroundAudioProcessorEditor::timerCallback()
+{
+    inputLevels = audioProcessor.getInputLevels();
+    outputLevels = audioProcessor.getOutputLevels();
+    qualityTier = audioProcessor.getQualityTier();
+    processingLoad = audioProcessor.getProcessingLoad();
+    sessionLoad = audioProcessor.getSessionLoad();
+    qualityPolicy = audioProcessor.getQualityPolicy();
+    repaint();
+}
+
+void FilterPlaygroundAudioProcessorEditor::resized()
+{
+    // This is generally where you'll want to lay out the positions of any
+    // subcomponents in your editor..
+    parameterEditor.setBounds(getLocalBounds().withTrimmedBottom(statusHeight));
+}
@@ -1,33 +1,47 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin editor.
-
-  ==============================================================================
-*/
-
-#pragma once
-
-#include <JuceHeader.h>
-#include "PluginProcessor.h"
-
-//==============================================================================
-/**
-*/
-class FilterPlaygroundAudioProcessorEditor  : public juce::AudioProcessorEditor
-{
-public:
-    FilterPlaygroundAudioProcessorEditor (FilterPlaygroundAudioProcessor&);
-    ~FilterPlaygroundAudioProcessorEditor() override;
-
-    //==============================================================================
-    void paint (juce::Graphics&) override;
-    void resized() override;
-
-private:
-    // This reference is provided as a quick way for your editor to
-    // access the processor object that created it.
-    FilterPlaygroundAudioProcessor& audioProcessor;
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FilterPlaygroundAudioProcessorEditor)
-};
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin editor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "PluginProcessor.h"
+
+//==============================================================================
+/**
+*/
+class FilterPlaygroundAudioProcessorEditor  : public juce::AudioProcessorEditor,
+                                               private juce::Timer
+{
+public:
+    FilterPlaygroundAudioProcessorEditor (FilterPlaygroundAudioProcessor&);
+    ~FilterPlaygroundAudioProcessorEditor() override;
+
+    //==============================================================================
+    void paint (juce::Graphics&) override;
+    void resized() override;
+
+private:
+    // This reference is provided as a quick way for your editor to
+    // access the processor object that created it.
+    FilterPlaygroundAudioProcessor& audioProcessor;
+    
+    // Every parameter, with the status lines drawn underneath
+    juce::GenericAudioProcessorEditor parameterEditor;
+    static constexpr int statusHeight = 80;
+    
+    // Polls the processor's meters, which is also what keeps them running
+    void timerCallback() override;
+    
+    LevelReadings inputLevels, outputLevels;
+    
+    QualityTier qualityTier {QualityTier::Full};
+    float processingLoad {0}, sessionLoad {0};
+    QualityPolicy qualityPolicy;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FilterPlaygroundAudioProcessorEditor)
+};
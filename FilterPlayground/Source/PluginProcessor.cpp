@@ -1,292 +1,1138 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin processor.
-
-  ==============================================================================
-*/
-
-#include "PluginProcessor.h"
-#include "PluginEditor.h"
-
-//==============================================================================
-FilterPlaygroundAudioProcessor::FilterPlaygroundAudioProcessor()
-#ifndef JucePlugin_PreferredChannelConfigurations
-     : AudioProcessor (BusesProperties()
-                     #if ! JucePlugin_IsMidiEffect
-                      #if ! JucePlugin_IsSynth
-                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
-                      #endif
-                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
-                     #endif
-                       )
-#endif
-{
-}
-
-FilterPlaygroundAudioProcessor::~FilterPlaygroundAudioProcessor()
-{
-}
-
-//==============================================================================
-const juce::String FilterPlaygroundAudioProcessor::getName() const
-{
-    return JucePlugin_Name;
-}
-
-bool FilterPlaygroundAudioProcessor::acceptsMidi() const
-{
-   #if JucePlugin_WantsMidiInput
-    return true;
-   #else
-    return false;
-   #endif
-}
-
-bool FilterPlaygroundAudioProcessor::producesMidi() const
-{
-   #if JucePlugin_ProducesMidiOutput
-    return true;
-   #else
-    return false;
-   #endif
-}
-
-bool FilterPlaygroundAudioProcessor::isMidiEffect() const
-{
-   #if JucePlugin_IsMidiEffect
-    return true;
-   #else
-    return false;
-   #endif
-}
-
-double FilterPlaygroundAudioProcessor::getTailLengthSeconds() const
-{
-    return 0.0;
-}
-
-int FilterPlaygroundAudioProcessor::getNumPrograms()
-{
-    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
-                // so this should be at least 1, even if you're not really implementing programs.
-}
-
-int FilterPlaygroundAudioProcessor::getCurrentProgram()
-{
-    return 0;
-}
-
-void FilterPlaygroundAudioProcessor::setCurrentProgram (int index)
-{
-}
-
-const juce::String FilterPlaygroundAudioProcessor::getProgramName (int index)
-{
-    return {};
-}
-
-void FilterPlaygroundAudioProcessor::changeProgramName (int index, const juce::String& newName)
-{
-}
-
-//==============================================================================
-void FilterPlaygroundAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
-{
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
-    juce::dsp::ProcessSpec spec;
-    
-    spec.maximumBlockSize = samplesPerBlock;
-    
-    spec.numChannels = 1;
-    
-    spec.sampleRate = sampleRate;
-    
-    leftChain.prepare(spec);
-    rightChain.prepare(spec);
-    
-    updateFilters();
-}
-
-void FilterPlaygroundAudioProcessor::updateFilters()
-{
-    auto chainSettings = getChainSettings(apvts);
-    updateLowPassFilter(chainSettings);
-}
-
-
-void FilterPlaygroundAudioProcessor::updateLowPassFilter(const ChainSettings &chainSettings)
-{
-    DBG("updateLowPassFilterFromScratch");
-    DBG("chainSettings.lowPassFreq:");
-    DBG(chainSettings.lowPassFreq);
-    
-    // Generating the coefficients
-    auto lowPassCoefficients = cFilter.makeCoefficients(getSampleRate(), chainSettings.lowPassFreq);
-    
-    auto& leftLowPass = leftChain.get<ChainPositions::LowPass>();
-    updateFilter(leftLowPass, lowPassCoefficients, chainSettings.lowPassSlope);
-    
-    auto& rightLowPass = rightChain.get<ChainPositions::LowPass>();
-    updateFilter(rightLowPass, lowPassCoefficients, chainSettings.lowPassSlope);
-}
-
-template<typename ChainType, typename CoefficientType>
-void FilterPlaygroundAudioProcessor::updateFilter(ChainType &type,
-                     const CoefficientType &coefficients,
-                     const Slope &slope
-                     )
-{
-    type.template setBypassed<0>(true);
-    
-    update<0>(type, coefficients);
-    
-}
-template<int Index, typename ChainType, typename CoefficientType>
-void FilterPlaygroundAudioProcessor::update(ChainType &chain, const CoefficientType &coefficients)
-{
-    updateCoefficents(chain.template get<Index>().coefficients, coefficients[Index]);
-    chain.template setBypassed<Index>(false);
-}
-
-void FilterPlaygroundAudioProcessor::updateCoefficents(Coefficients &old, const Coefficients &replacememts)
-{
-    *old = *replacememts;
-}
-
-void FilterPlaygroundAudioProcessor::releaseResources()
-{
-    // When playback stops, you can use this as an opportunity to free up any
-    // spare memory, etc.
-}
-
-#ifndef JucePlugin_PreferredChannelConfigurations
-bool FilterPlaygroundAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
-{
-  #if JucePlugin_IsMidiEffect
-    juce::ignoreUnused (layouts);
-    return true;
-  #else
-    // This is the place where you check if the layout is supported.
-    // In this template code we only support mono or stereo.
-    // Some plugin hosts, such as certain GarageBand versions, will only
-    // load plugins that support stereo bus layouts.
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
-        return false;
-
-    // This checks if the input layout matches the output layout
-   #if ! JucePlugin_IsSynth
-    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
-        return false;
-   #endif
-
-    return true;
-  #endif
-}
-#endif
-
-void FilterPlaygroundAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
-{
-    juce::ScopedNoDenormals noDenormals;
-    auto totalNumInputChannels  = getTotalNumInputChannels();
-    auto totalNumOutputChannels = getTotalNumOutputChannels();
-
-    // In case we have more outputs than inputs, this code clears any output
-    // channels that didn't contain input data, (because these aren't
-    // guaranteed to be empty - they may contain garbage).
-    // This is here to avoid people getting screaming feedback
-    // when they first compile a plugin, but obviously you don't need to keep
-    // this code if your algorithm always overwrites all the output channels.
-    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
-        buffer.clear (i, 0, buffer.getNumSamples());
-
-   
-    updateFilters();
-    
-
-    juce::dsp::AudioBlock<float> block(buffer);
-    
-    auto leftBlock = block.getSingleChannelBlock(0);
-    auto rightBlock = block.getSingleChannelBlock(1);
-    
-    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
-    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
-    
-    leftChain.process(leftContext);
-    rightChain.process(rightContext);
-}
-
-//==============================================================================
-bool FilterPlaygroundAudioProcessor::hasEditor() const
-{
-    return true; // (change this to false if you choose to not supply an editor)
-}
-
-juce::AudioProcessorEditor* FilterPlaygroundAudioProcessor::createEditor()
-{
-//    return new FilterPlaygroundAudioProcessorEditor (*this);
-    return new juce::GenericAudioProcessorEditor(*this);
-}
-
-//==============================================================================
-void FilterPlaygroundAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
-{
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-}
-
-void FilterPlaygroundAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
-{
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-}
-
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
-{
-    ChainSettings settings;
-    
-    settings.lowPassFreq = apvts.getRawParameterValue("LowPass Freq")->load();
-    settings.lowPassSlope = static_cast<Slope>(apvts.getRawParameterValue("LowPass Slope")->load());
-    settings.resonance = apvts.getRawParameterValue("Resonance")->load();
-    
-    return settings;
-}
-
-juce::AudioProcessorValueTreeState::ParameterLayout FilterPlaygroundAudioProcessor::createParameterLayout()
-{
-    juce::AudioProcessorValueTreeState::ParameterLayout layout;
-    
-    
-    layout.add(std::make_unique<juce::AudioParameterFloat>("LowPass Freq",
-                                                           "LowPass Freq",
-                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
-                                                           1000.f));
-    
-    layout.add(std::make_unique<juce::AudioParameterFloat>("Resonance",
-                                                           "Resonance",
-                                                           juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f),
-                                                           0.f));
-        
-    juce::StringArray stringArray;
-    for( int i = 0; i < 2; ++i )
-    {
-        juce::String str;
-        str << (6 + i*6);
-        str << " db/Oct";
-        stringArray.add(str);
-    }
-    layout.add(std::make_unique<juce::AudioParameterChoice>("LowPass Slope", "LowPass Slope", stringArray, 0));
-
-    return layout;
-}
-
-
-//==============================================================================
-// This creates new instances of the plugin..
-juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
-{
-    return new FilterPlaygroundAudioProcessor();
-}
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin processor.
+
+  ==============================================================================
+*/
+
+#include "PluginProcessor.h"
+#include "PluginEditor.h"
+
+//==============================================================================
+FilterPlaygroundAudioProcessor::FilterPlaygroundAudioProcessor()
+#ifndef JucePlugin_PreferredChannelConfigurations
+     : AudioProcessor (BusesProperties()
+                     #if ! JucePlugin_IsMidiEffect
+                      #if ! JucePlugin_IsSynth
+                       .withInput  ("Input",  juce::AudioChannelSet::stereo(), true)
+                       .withInput  ("Sidechain", juce::AudioChannelSet::stereo(), false)
+                      #endif
+                       .withOutput ("Output", juce::AudioChannelSet::stereo(), true)
+                     #endif
+                       )
+#endif
+{
+}
+
+FilterPlaygroundAudioProcessor::~FilterPlaygroundAudioProcessor()
+{
+    workers->cancelAndWait(spectralLayoutJob);
+}
+
+//==============================================================================
+const juce::String FilterPlaygroundAudioProcessor::getName() const
+{
+    return JucePlugin_Name;
+}
+
+bool FilterPlaygroundAudioProcessor::acceptsMidi() const
+{
+   #if JucePlugin_WantsMidiInput
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+bool FilterPlaygroundAudioProcessor::producesMidi() const
+{
+   #if JucePlugin_ProducesMidiOutput
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+bool FilterPlaygroundAudioProcessor::isMidiEffect() const
+{
+   #if JucePlugin_IsMidiEffect
+    return true;
+   #else
+    return false;
+   #endif
+}
+
+double FilterPlaygroundAudioProcessor::getTailLengthSeconds() const
+{
+    return 0.0;
+}
+
+int FilterPlaygroundAudioProcessor::getNumPrograms()
+{
+    return 1;   // NB: some hosts don't cope very well if you tell them there are 0 programs,
+                // so this should be at least 1, even if you're not really implementing programs.
+}
+
+int FilterPlaygroundAudioProcessor::getCurrentProgram()
+{
+    return 0;
+}
+
+void FilterPlaygroundAudioProcessor::setCurrentProgram (int index)
+{
+}
+
+const juce::String FilterPlaygroundAudioProcessor::getProgramName (int index)
+{
+    return {};
+}
+
+void FilterPlaygroundAudioProcessor::changeProgramName (int index, const juce::String& newName)
+{
+}
+
+//==============================================================================
+void FilterPlaygroundAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
+{
+    // Use this method as the place to do any pre-playback
+    // initialisation that you need..
+    juce::dsp::ProcessSpec spec;
+    
+    spec.maximumBlockSize = samplesPerBlock;
+    
+    spec.numChannels = 1;
+    
+    spec.sampleRate = sampleRate;
+    
+    leftChain.prepare(spec);
+    rightChain.prepare(spec);
+    
+    filterKernels = &FilterKernelDispatch::select();
+    
+    for( auto* chain : { &leftChain, &rightChain } )
+        chain->get<ChainPositions::LowPass>().get<0>().setKernels(filterKernels->process, filterKernels->processRamp);
+    
+    cFilter.prepare(*sharedResources, sampleRate);
+    
+    leftLadder.prepare(sampleRate);
+    rightLadder.prepare(sampleRate);
+    
+    updateFilters();
+    appliedCutoff = getChainSettings(apvts).lowPassFreq;
+    
+    preparedBlockSize = samplesPerBlock;
+    auto maxModulationSteps = samplesPerBlock / controlInterval + 1;
+    
+    auto maximumDelay = static_cast<float> (sampleRate / minimumDelayFrequency);
+    
+    dspArena.allocate(ModulationEngine::getArenaBytes(maxModulationSteps)
+                      + 2 * LevelMeter::getArenaBytes(samplesPerBlock)
+                      + FilterGraphPlayer::getArenaBytes(samplesPerBlock, 2)
+                      + 2 * DelayLineFilter::getArenaBytes(maximumDelay)
+                      + SpectralFilter::getArenaBytes(samplesPerBlock));
+    
+    for( auto* delay : { &leftDelay, &rightDelay } )
+        delay->prepare(dspArena, maximumDelay);
+    
+    envelopeFollower.prepare(sampleRate, controlInterval);
+    modulation.prepare(dspArena, sampleRate, controlInterval, maxModulationSteps);
+    lowPassModulated = false;
+    modulatedTier = QualityTier::Full;
+    inputMeter.prepare(dspArena, sampleRate, samplesPerBlock, getMainBusNumInputChannels());
+    outputMeter.prepare(dspArena, sampleRate, samplesPerBlock, getMainBusNumOutputChannels());
+    
+    // The ladders start out in the tier's antialiasing instead of fading to it on the first block
+    auto chainSettings = getChainSettings(apvts);
+    qualityGovernor.prepare(sampleRate, sharedResources->getSessionLoad());
+    qualityGovernor.setMode(chainSettings.qualityMode);
+    setLadderParameters(chainSettings.lowPassFreq, chainSettings.resonance, qualityGovernor.getTier());
+    leftLadder.reset();
+    rightLadder.reset();
+    
+    // Only Spectral mode holds an STFT layout, built for the FFT size it's set to and running
+    // from the first block
+    activeFilterMode = chainSettings.filterMode;
+    workers->cancelAndWait(spectralLayoutJob);
+    spectralFilter.prepare(dspArena, *sharedResources, sampleRate, samplesPerBlock);
+    setSpectralParameters(chainSettings, chainSettings.lowPassFreq);
+    
+    builtSpectralLayout = 0;
+    requestedSpectralLayout = getSpectralLayout(chainSettings).pack();
+    buildSpectralLayout();
+    spectralFilter.adoptPendingLayout();
+    
+    requestedLatency = getSpectralLatency();
+    pendingLatency = requestedLatency;
+    setLatencySamples(requestedLatency);
+    
+    graphPlayer.prepare(dspArena, samplesPerBlock, 2, static_cast<int> (sampleRate * 0.02));
+    graphPlayer.resetGraph(compileProcessingGraph());
+}
+
+FilterPlaygroundAudioProcessor::DspFootprint FilterPlaygroundAudioProcessor::getDspFootprint() const noexcept
+{
+    return { sizeof(*this), dspArena.getCapacity(), spectralFilter.getMemoryBytes(), graphPlayer.getMemoryBytes() };
+}
+
+bool FilterPlaygroundAudioProcessor::exportTimelineTrace(const juce::File& file) const
+{
+   #if FILTERPLAYGROUND_TRACE
+    return TraceRecorder::exportChromeTrace(file);
+   #else
+    juce::ignoreUnused(file);
+    return false;
+   #endif
+}
+
+void FilterPlaygroundAudioProcessor::setProcessingGraph(const FilterGraphDescription& description)
+{
+    graphDescription = description;
+    
+    // Not prepared yet, prepareToPlay will compile it
+    if (getSampleRate() <= 0)
+        return;
+    
+    graphPlayer.setGraph(compileProcessingGraph());
+}
+
+std::unique_ptr<CompiledFilterGraph> FilterPlaygroundAudioProcessor::compileProcessingGraph() const
+{
+    if (graphDescription.nodes.empty())
+        return nullptr;
+    
+    return CompiledFilterGraph::compile(graphDescription, getSampleRate(), getBlockSize(), 2);
+}
+
+void FilterPlaygroundAudioProcessor::updateFilters()
+{
+    auto chainSettings = getChainSettings(apvts);
+    updateLowPassFilter(chainSettings);
+}
+
+
+void FilterPlaygroundAudioProcessor::updateLowPassFilter(const ChainSettings &chainSettings)
+{
+    DBG("updateLowPassFilterFromScratch");
+    DBG("chainSettings.lowPassFreq:");
+    DBG(chainSettings.lowPassFreq);
+    
+    // Generating the coefficient
+    auto lowPassAlpha = cFilter.getAlpha(getSampleRate(), chainSettings.lowPassFreq);
+    
+    auto& leftLowPass = leftChain.get<ChainPositions::LowPass>();
+    updateFilter(leftLowPass, lowPassAlpha, chainSettings.lowPassSlope);
+    
+    auto& rightLowPass = rightChain.get<ChainPositions::LowPass>();
+    updateFilter(rightLowPass, lowPassAlpha, chainSettings.lowPassSlope);
+}
+
+template<typename ChainType, typename CoefficientType>
+void FilterPlaygroundAudioProcessor::updateFilter(ChainType &type,
+                     const CoefficientType &coefficients,
+                     const Slope &slope
+                     )
+{
+    type.template setBypassed<0>(true);
+    
+    update<0>(type, coefficients);
+    
+}
+template<int Index, typename ChainType, typename CoefficientType>
+void FilterPlaygroundAudioProcessor::update(ChainType &chain, const CoefficientType &coefficients)
+{
+    chain.template get<Index>().setAlpha(coefficients);
+    chain.template setBypassed<Index>(false);
+}
+
+void FilterPlaygroundAudioProcessor::updateLowPassCutoff(float cutoff)
+{
+    FP_TRACE_SCOPE("updateFilters");
+    
+    if (cutoff == appliedCutoff)
+        return;
+    
+    appliedCutoff = cutoff;
+    setLowPassAlpha(cFilter.getAlpha(getSampleRate(), cutoff));
+}
+
+void FilterPlaygroundAudioProcessor::setLowPassAlpha(float alpha)
+{
+    leftChain.get<ChainPositions::LowPass>().get<0>().setAlpha(alpha);
+    rightChain.get<ChainPositions::LowPass>().get<0>().setAlpha(alpha);
+}
+
+// Ramps per sample from the current alpha over the next processed block
+void FilterPlaygroundAudioProcessor::setLowPassTargetAlpha(float alpha)
+{
+    leftChain.get<ChainPositions::LowPass>().get<0>().setTargetAlpha(alpha);
+    rightChain.get<ChainPositions::LowPass>().get<0>().setTargetAlpha(alpha);
+}
+
+void FilterPlaygroundAudioProcessor::processChains(juce::dsp::AudioBlock<float>& block)
+{
+    FP_TRACE_SCOPE("processChains");
+    
+    auto leftBlock = block.getSingleChannelBlock(0);
+    juce::dsp::ProcessContextReplacing<float> leftContext(leftBlock);
+    
+    if (isDualMono(block))
+    {
+        leftChain.process(leftContext);
+        copyLeftToRight(block);
+        return;
+    }
+    
+    if (block.getNumChannels() < 2)
+    {
+        leftChain.process(leftContext);
+        return;
+    }
+    
+    auto& leftLowPass = leftChain.get<ChainPositions::LowPass>().get<0>().getState();
+    auto& rightLowPass = rightChain.get<ChainPositions::LowPass>().get<0>().getState();
+    
+    // Both channels steady at the same cutoff, which is every unmodulated block: one loop for the pair
+    if (leftLowPass.alpha == leftLowPass.targetAlpha && rightLowPass.alpha == rightLowPass.targetAlpha
+        && leftLowPass.alpha == rightLowPass.alpha
+        && ! leftChain.get<ChainPositions::LowPass>().isBypassed<0>()
+        && ! rightChain.get<ChainPositions::LowPass>().isBypassed<0>())
+    {
+        filterKernels->processStereo(leftLowPass.s, rightLowPass.s, leftLowPass.alpha,
+                                     block.getChannelPointer(0), block.getChannelPointer(1), static_cast<int> (block.getNumSamples()));
+        
+        // Same denormal flush as OnePoleLowPass::process
+        for( auto* state : { &leftLowPass, &rightLowPass } )
+            if (std::abs(state->s) < 1.0e-15f)
+                state->s = 0;
+        
+        return;
+    }
+    
+    leftChain.process(leftContext);
+    
+    auto rightBlock = block.getSingleChannelBlock(1);
+    juce::dsp::ProcessContextReplacing<float> rightContext(rightBlock);
+    rightChain.process(rightContext);
+}
+
+bool FilterPlaygroundAudioProcessor::isDualMono(const juce::dsp::AudioBlock<float>& block) const noexcept
+{
+    if (block.getNumChannels() < 2)
+        return false;
+    
+    auto& leftLowPass = leftChain.get<ChainPositions::LowPass>().get<0>().getState();
+    auto& rightLowPass = rightChain.get<ChainPositions::LowPass>().get<0>().getState();
+    
+    // Cheapest test first. memcmp is vectorised and stops at the first differing sample,
+    // so real stereo costs next to nothing and identical channels cost one pass over both.
+    return leftLowPass.s == rightLowPass.s
+        && leftLowPass.alpha == rightLowPass.alpha
+        && leftLowPass.targetAlpha == rightLowPass.targetAlpha
+        && std::memcmp(block.getChannelPointer(0), block.getChannelPointer(1), block.getNumSamples() * sizeof(float)) == 0;
+}
+
+// After running only the left chain: the right output and state become exact copies, so if the
+// channels diverge on a later block the right chain carries on from the same state.
+void FilterPlaygroundAudioProcessor::copyLeftToRight(juce::dsp::AudioBlock<float>& block) noexcept
+{
+    juce::FloatVectorOperations::copy(block.getChannelPointer(1), block.getChannelPointer(0), static_cast<int> (block.getNumSamples()));
+    
+    rightChain.get<ChainPositions::LowPass>().get<0>().getState() = leftChain.get<ChainPositions::LowPass>().get<0>().getState();
+}
+
+bool FilterPlaygroundAudioProcessor::canProcessChainsInParallel(const juce::dsp::AudioBlock<float>& block)
+{
+    auto& leftLowPass = leftChain.get<ChainPositions::LowPass>().get<0>().getState();
+    auto& rightLowPass = rightChain.get<ChainPositions::LowPass>().get<0>().getState();
+    
+    // Only the coefficient-constant case splits in time
+    return isNonRealtime()
+        && block.getNumSamples() >= (size_t) ParallelOnePole::minimumParallelSamples
+        && leftLowPass.alpha == leftLowPass.targetAlpha
+        && rightLowPass.alpha == rightLowPass.targetAlpha
+        && leftLowPass.alpha == rightLowPass.alpha;
+}
+
+void FilterPlaygroundAudioProcessor::processChainsInParallel(juce::dsp::AudioBlock<float>& block)
+{
+    FP_TRACE_SCOPE("processChainsInParallel");
+    
+    auto& leftLowPass = leftChain.get<ChainPositions::LowPass>().get<0>().getState();
+    auto& rightLowPass = rightChain.get<ChainPositions::LowPass>().get<0>().getState();
+    
+    auto dualMono = isDualMono(block);
+    auto numChannels = dualMono ? 1 : juce::jmin(2, static_cast<int> (block.getNumChannels()));
+    float* channels[2] = { block.getChannelPointer(0), numChannels > 1 ? block.getChannelPointer(1) : nullptr };
+    float states[2] = { leftLowPass.s, rightLowPass.s };
+    
+    ParallelOnePole::process(*workers, channels, states, numChannels, leftLowPass.alpha, static_cast<int> (block.getNumSamples()),
+                             filterKernels->process);
+    
+    leftLowPass.s = states[0];
+    rightLowPass.s = states[1];
+    
+    if (dualMono)
+        copyLeftToRight(block);
+}
+
+void FilterPlaygroundAudioProcessor::setLadderParameters(float cutoff, float resonance, QualityTier tier) noexcept
+{
+    auto amount = LadderFilter::getResonanceAmount(resonance);
+    auto antialiasing = tier == QualityTier::Minimum ? LadderAntialiasing::None : LadderAntialiasing::FirstOrder;
+    
+    for( auto* ladder : { &leftLadder, &rightLadder } )
+    {
+        ladder->setParameters(cutoff, amount);
+        ladder->setAntialiasing(antialiasing);
+    }
+}
+
+void FilterPlaygroundAudioProcessor::processLadders(juce::dsp::AudioBlock<float>& block)
+{
+    FP_TRACE_SCOPE("processLadders");
+    
+    auto numSamples = static_cast<int> (block.getNumSamples());
+    auto* left = block.getChannelPointer(0);
+    
+    leftLadder.process(left, left, numSamples);
+    
+    if (block.getNumChannels() < 2)
+        return;
+    
+    auto* right = block.getChannelPointer(1);
+    rightLadder.process(right, right, numSamples);
+}
+
+void FilterPlaygroundAudioProcessor::setSpectralParameters(const ChainSettings& chainSettings, float cutoff) noexcept
+{
+    spectralFilter.setParameters(chainSettings.spectralMode, cutoff, chainSettings.spectralThreshold);
+}
+
+SpectralLayoutSettings FilterPlaygroundAudioProcessor::getSpectralLayout(const ChainSettings& chainSettings) noexcept
+{
+    if (chainSettings.filterMode != FilterMode::Spectral)
+        return {};
+    
+    return { chainSettings.fftOrder, chainSettings.fftOverlap, chainSettings.fftWindow };
+}
+
+// Audio thread. The layout is built on a worker and picked up by a later block, which crossfades
+// to it from the old one (or from the dry input when there was none). Offline with no layout at
+// all there's nothing to keep running and nothing waits on the block, so it's built right here.
+void FilterPlaygroundAudioProcessor::requestSpectralLayout(const ChainSettings& chainSettings)
+{
+    auto layout = getSpectralLayout(chainSettings).pack();
+    
+    if (layout == requestedSpectralLayout.load(std::memory_order_relaxed))
+        return;
+    
+    requestedSpectralLayout.store(layout);
+    
+    if (isNonRealtime() && layout != 0 && ! spectralFilter.hasLayout())
+        buildSpectralLayout();
+    else
+        workers->submit(spectralLayoutJob, WorkerJob::Lane::High);
+}
+
+void FilterPlaygroundAudioProcessor::buildSpectralLayout()
+{
+    const juce::ScopedLock sl (spectralLayoutLock);
+    
+    auto layout = requestedSpectralLayout.load();
+    
+    if (layout == builtSpectralLayout)
+        return;
+    
+    builtSpectralLayout = layout;
+    spectralFilter.setLayout(SpectralLayoutSettings::unpack(layout));
+}
+
+// Audio thread: the layout that's running, not the one asked for, so the host hears about a new
+// FFT size when its output does
+int FilterPlaygroundAudioProcessor::getSpectralLatency() const noexcept
+{
+    if (activeFilterMode != FilterMode::Spectral || ! spectralFilter.hasLayout())
+        return 0;
+    
+    return SpectralFilter::getLatencySamples(spectralFilter.getLayout().order);
+}
+
+void FilterPlaygroundAudioProcessor::processSpectral(juce::dsp::AudioBlock<float>& block)
+{
+    FP_TRACE_SCOPE("processSpectral");
+    
+    spectralFilter.process(block);
+}
+
+// Audio thread. Hosts expect setLatencySamples() from the message thread, so it's only noted here.
+void FilterPlaygroundAudioProcessor::updateLatency() noexcept
+{
+    auto latency = getSpectralLatency();
+    
+    if (latency == requestedLatency)
+        return;
+    
+    requestedLatency = latency;
+    pendingLatency.store(latency);
+    triggerAsyncUpdate();
+}
+
+void FilterPlaygroundAudioProcessor::handleAsyncUpdate()
+{
+    setLatencySamples(pendingLatency.load());
+}
+
+size_t FilterPlaygroundAudioProcessor::getDspStateSize() const
+{
+    return sizeof(DspSnapshotHeader) + leftDelay.getStateSize() + rightDelay.getStateSize()
+         + spectralFilter.getStateSize() + graphPlayer.getStateSize();
+}
+
+size_t FilterPlaygroundAudioProcessor::captureDspState(void* dest, size_t capacity) const noexcept
+{
+    auto* graph = graphPlayer.getActiveGraph();
+    
+    DspSnapshotHeader header;
+    header.magic = DspSnapshotHeader::magicNumber;
+    header.version = DspSnapshotHeader::currentVersion;
+    header.sampleRate = getSampleRate();
+    header.filterMode = static_cast<juce::int32> (activeFilterMode);
+    header.lowPass[0] = leftChain.get<ChainPositions::LowPass>().get<0>().getState();
+    header.lowPass[1] = rightChain.get<ChainPositions::LowPass>().get<0>().getState();
+    header.lowPassModulated = lowPassModulated;
+    header.ladder[0] = leftLadder.getState();
+    header.ladder[1] = rightLadder.getState();
+    header.envelopeFollower = envelopeFollower.getState();
+    header.modulation = modulation.getState();
+    header.delayActive = delayActive;
+    header.delayStateSize = static_cast<juce::uint32> (leftDelay.getStateSize() + rightDelay.getStateSize());
+    header.spectralLayout = spectralFilter.getLayout().pack();
+    header.spectralStateSize = static_cast<juce::uint32> (SpectralFilter::getStateSize(spectralFilter.getLayout()));
+    header.graphNodes = graph != nullptr ? graph->getNumNodes() : -1;
+    header.graphStateSize = graph != nullptr ? static_cast<juce::uint32> (graph->getStateSize()) : 0;
+    
+    DspSnapshotWriter writer { static_cast<char*> (dest), capacity };
+    
+    if (! writer.write(&header, sizeof(header))
+        || capacity - writer.position < (size_t) header.delayStateSize + header.spectralStateSize + header.graphStateSize)
+        return 0;
+    
+    leftDelay.saveState(writer.data + writer.position);
+    rightDelay.saveState(writer.data + writer.position + leftDelay.getStateSize());
+    writer.position += header.delayStateSize;
+    
+    spectralFilter.saveState(writer.data + writer.position);
+    writer.position += header.spectralStateSize;
+    
+    if (graph != nullptr)
+        graph->saveState(writer.data + writer.position);
+    
+    return writer.position + header.graphStateSize;
+}
+
+bool FilterPlaygroundAudioProcessor::restoreDspState(const void* source, size_t size) noexcept
+{
+    auto* graph = graphPlayer.getActiveGraph();
+    
+    DspSnapshotReader reader { static_cast<const char*> (source), size };
+    DspSnapshotHeader header;
+    
+    // A layout built since the last block is what the next one runs, compare against that
+    spectralFilter.adoptPendingLayout();
+    
+    if (! reader.read(&header, sizeof(header))
+        || header.magic != DspSnapshotHeader::magicNumber
+        || header.version != DspSnapshotHeader::currentVersion
+        || header.sampleRate != getSampleRate())
+        return false;
+    
+    // The delay lines are sized by the sample rate, the STFT frames and the graph's memories only
+    // make sense for the same layout and graph
+    if (header.delayStateSize != leftDelay.getStateSize() + rightDelay.getStateSize()
+        || header.spectralStateSize != SpectralFilter::getStateSize(spectralFilter.getLayout())
+        || header.spectralLayout != spectralFilter.getLayout().pack()
+        || header.graphNodes != (graph != nullptr ? graph->getNumNodes() : -1)
+        || header.graphStateSize != (graph != nullptr ? graph->getStateSize() : 0))
+        return false;
+    
+    auto* delayState = reader.skip(header.delayStateSize);
+    auto* spectralState = reader.skip(header.spectralStateSize);
+    auto* graphState = reader.skip(header.graphStateSize);
+    
+    if (delayState == nullptr || spectralState == nullptr || graphState == nullptr)
+        return false;
+    
+    // Restoring the mode too keeps the next block from treating it as a switch and resetting
+    // the ladder and STFT state restored below
+    activeFilterMode = static_cast<FilterMode> (header.filterMode);
+    leftChain.get<ChainPositions::LowPass>().get<0>().getState() = header.lowPass[0];
+    rightChain.get<ChainPositions::LowPass>().get<0>().getState() = header.lowPass[1];
+    lowPassModulated = header.lowPassModulated;
+    leftLadder.getState() = header.ladder[0];
+    rightLadder.getState() = header.ladder[1];
+    envelopeFollower.setState(header.envelopeFollower);
+    modulation.setState(header.modulation);
+    
+    delayActive = header.delayActive;
+    leftDelay.loadState(delayState);
+    rightDelay.loadState(delayState + leftDelay.getStateSize());
+    
+    spectralFilter.loadState(spectralState);
+    
+    if (graph != nullptr)
+        graph->loadState(graphState);
+    
+    return true;
+}
+
+void FilterPlaygroundAudioProcessor::processDelays(juce::dsp::AudioBlock<float>& block, const ChainSettings& chainSettings)
+{
+    // Switched on, the lines start empty rather than with whatever they held last time
+    if (chainSettings.delayEnabled != delayActive)
+    {
+        leftDelay.reset();
+        rightDelay.reset();
+        delayActive = chainSettings.delayEnabled;
+    }
+    
+    if (! delayActive)
+        return;
+    
+    FP_TRACE_SCOPE("processDelays");
+    
+    auto delaySamples = static_cast<float> (getSampleRate()) / chainSettings.delayFrequency;
+    auto numSamples = static_cast<int> (block.getNumSamples());
+    
+    for( size_t ch = 0; ch < juce::jmin((size_t) 2, block.getNumChannels()); ++ch )
+    {
+        auto& delay = ch == 0 ? leftDelay : rightDelay;
+        auto* samples = block.getChannelPointer(ch);
+        
+        delay.setParameters(chainSettings.delayStructure, chainSettings.delayInterpolation, delaySamples, chainSettings.delayGain);
+        delay.process(samples, samples, numSamples);
+    }
+}
+
+bool FilterPlaygroundAudioProcessor::isSidechainConnected() const
+{
+    return getBusCount(true) > 1 && getBus(true, 1)->isEnabled() && getChannelCountOfBus(true, 1) > 0;
+}
+
+ModulationEngine::Transport FilterPlaygroundAudioProcessor::getTransport()
+{
+    ModulationEngine::Transport transport;
+    
+    if (auto* playHead = getPlayHead())
+    {
+        juce::AudioPlayHead::CurrentPositionInfo info;
+        
+        if (playHead->getCurrentPosition(info))
+        {
+            transport.bpm = info.bpm > 0 ? info.bpm : 120.0;
+            transport.ppqPosition = info.ppqPosition;
+            transport.isPlaying = info.isPlaying;
+        }
+    }
+    
+    return transport;
+}
+
+void FilterPlaygroundAudioProcessor::processModulated(juce::dsp::AudioBlock<float>& block,
+                                                      const juce::AudioBuffer<float>* sidechain,
+                                                      int startSample,
+                                                      const ChainSettings& chainSettings,
+                                                      QualityTier tier)
+{
+    FP_TRACE_SCOPE("processModulated");
+    
+    if (sidechain != nullptr)
+        envelopeFollower.setParameters(chainSettings.sidechainMode, chainSettings.sidechainAttack, chainSettings.sidechainRelease);
+    
+    auto sampleRate = getSampleRate();
+    auto maxCutoff = juce::jmin(SharedDspResources::maxTableFrequency, static_cast<float> (sampleRate * 0.49));
+    auto numSamples = static_cast<int> (block.getNumSamples());
+    auto* matrixOctaves = modulation.getCutoffOctaves();
+    auto* matrixResonance = modulation.getResonanceOffsets();
+    
+    // Lower tiers recompute the cutoff less often. The envelope still runs every control step so
+    // its timing doesn't depend on the tier, and the first update after a tier change is always
+    // ramped so switching to stepped updates doesn't click.
+    auto stepsPerUpdate = QualityGovernor::getStepsPerCoefficientUpdate(tier);
+    auto updateLength = controlInterval * stepsPerUpdate;
+    auto ramp = QualityGovernor::rampsCoefficients(tier) || tier != modulatedTier;
+    modulatedTier = tier;
+    
+    for( int start = 0, step = 0; start < numSamples; start += updateLength, step += stepsPerUpdate )
+    {
+        auto numUpdateSamples = juce::jmin(updateLength, numSamples - start);
+        auto octaves = matrixOctaves[step];
+        
+        if (sidechain != nullptr)
+        {
+            auto envelope = 0.f;
+            
+            for( int offset = 0; offset < numUpdateSamples; offset += controlInterval )
+                envelope = envelopeFollower.processControlStep(sidechain->getArrayOfReadPointers(),
+                                                               sidechain->getNumChannels(),
+                                                               startSample + start + offset,
+                                                               juce::jmin(controlInterval, numUpdateSamples - offset));
+            
+            octaves += chainSettings.sidechainAmount * envelope;
+        }
+        
+        auto cutoff = juce::jlimit(20.f, maxCutoff, chainSettings.lowPassFreq * std::exp2(octaves));
+        auto updateBlock = block.getSubBlock(static_cast<size_t> (start), static_cast<size_t> (numUpdateSamples));
+        
+        // Ladder coefficients are one tan() away and its TPT stages take steps cleanly, no ramp needed
+        if (chainSettings.filterMode == FilterMode::Ladder)
+        {
+            setLadderParameters(cutoff, chainSettings.resonance + matrixResonance[step], tier);
+            processLadders(updateBlock);
+            continue;
+        }
+        
+        // The spectral shape follows the cutoff from its next frame on
+        if (chainSettings.filterMode == FilterMode::Spectral)
+        {
+            setSpectralParameters(chainSettings, cutoff);
+            processSpectral(updateBlock);
+            continue;
+        }
+        
+        auto alpha = cFilter.getAlpha(sampleRate, cutoff);
+        
+        if (ramp)
+            setLowPassTargetAlpha(alpha);
+        else
+            setLowPassAlpha(alpha);
+        
+        ramp = QualityGovernor::rampsCoefficients(tier);
+        processChains(updateBlock);
+    }
+    
+    lowPassModulated = true;
+}
+
+void FilterPlaygroundAudioProcessor::releaseResources()
+{
+    // When playback stops, you can use this as an opportunity to free up any
+    // spare memory, etc.
+    graphPlayer.collectGarbage();
+    workers->cancelAndWait(spectralLayoutJob);
+    spectralFilter.collectGarbage();
+    dspArena.release();
+}
+
+#ifndef JucePlugin_PreferredChannelConfigurations
+bool FilterPlaygroundAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const
+{
+  #if JucePlugin_IsMidiEffect
+    juce::ignoreUnused (layouts);
+    return true;
+  #else
+    // This is the place where you check if the layout is supported.
+    // In this template code we only support mono or stereo.
+    // Some plugin hosts, such as certain GarageBand versions, will only
+    // load plugins that support stereo bus layouts.
+    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
+     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+        return false;
+
+    // This checks if the input layout matches the output layout
+   #if ! JucePlugin_IsSynth
+    if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
+        return false;
+    
+    // Sidechain is optional, mono or stereo
+    if (layouts.inputBuses.size() > 1)
+    {
+        auto sidechain = layouts.getChannelSet(true, 1);
+        
+        if (! sidechain.isDisabled()
+         && sidechain != juce::AudioChannelSet::mono()
+         && sidechain != juce::AudioChannelSet::stereo())
+            return false;
+    }
+   #endif
+
+    return true;
+  #endif
+}
+#endif
+
+void FilterPlaygroundAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    FP_TRACE_SCOPE("processBlock");
+    
+    auto startTicks = juce::Time::getHighResolutionTicks();
+    
+    juce::ScopedNoDenormals noDenormals;
+    auto totalNumInputChannels  = getTotalNumInputChannels();
+    auto totalNumOutputChannels = getTotalNumOutputChannels();
+
+    // In case we have more outputs than inputs, this code clears any output
+    // channels that didn't contain input data, (because these aren't
+    // guaranteed to be empty - they may contain garbage).
+    // This is here to avoid people getting screaming feedback
+    // when they first compile a plugin, but obviously you don't need to keep
+    // this code if your algorithm always overwrites all the output channels.
+    for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
+        buffer.clear (i, 0, buffer.getNumSamples());
+
+    
+    // The main bus only, the sidechain channels live further down the same buffer
+    auto mainBuffer = getBusBuffer(buffer, false, 0);
+    juce::dsp::AudioBlock<float> block(mainBuffer);
+    forEachPreparedChunk(block, [this](juce::dsp::AudioBlock<float>& chunk) { inputMeter.process(chunk); });
+    
+    auto chainSettings = getChainSettings(apvts);
+    auto modulationSettings = modulationParameters.load();
+    
+    qualityGovernor.setMode(chainSettings.qualityMode);
+    auto tier = qualityGovernor.getTier();
+    
+    auto sidechainActive = isSidechainConnected() && chainSettings.sidechainAmount != 0;
+    auto ladder = chainSettings.filterMode == FilterMode::Ladder;
+    auto spectral = chainSettings.filterMode == FilterMode::Spectral;
+    
+    // The ladder also follows routes to Resonance, the clean low-pass has none
+    auto modulated = sidechainActive
+                  || ModulationEngine::targets(modulationSettings, ModTarget::Cutoff)
+                  || (ladder && ModulationEngine::targets(modulationSettings, ModTarget::Resonance));
+    
+    // Switching modes starts the ladder and the STFT from silence rather than whatever they held last time
+    if (chainSettings.filterMode != activeFilterMode)
+    {
+        leftLadder.reset();
+        rightLadder.reset();
+        spectralFilter.reset();
+        activeFilterMode = chainSettings.filterMode;
+    }
+    
+    if (ladder && ! modulated)
+        setLadderParameters(chainSettings.lowPassFreq, chainSettings.resonance, tier);
+    
+    if (spectral)
+        setSpectralParameters(chainSettings, chainSettings.lowPassFreq);
+    
+    requestSpectralLayout(chainSettings);
+    
+    // getBusBuffer only points into the host buffer, no samples are copied
+    auto sidechainBuffer = sidechainActive ? getBusBuffer(buffer, true, 1) : juce::AudioBuffer<float>();
+    
+    if (! modulated)
+    {
+        // Back from modulation the filter holds whatever cutoff it was last swept to
+        if (lowPassModulated)
+        {
+            appliedCutoff = -1.f;
+            lowPassModulated = false;
+        }
+        
+        updateLowPassCutoff(chainSettings.lowPassFreq);
+    }
+    
+    // Modulation sources keep running even when nothing is routed, so phases stay continuous.
+    // Blocks longer than the prepared size are handled in prepared-size chunks.
+    auto transport = getTransport();
+    auto numSamples = static_cast<int> (block.getNumSamples());
+    auto chunkLength = modulation.getMaxSteps() * controlInterval;
+    auto renderInParallel = ! modulated && chainSettings.filterMode == FilterMode::Clean && canProcessChainsInParallel(block);
+    
+    for( int start = 0; start < numSamples; start += chunkLength )
+    {
+        auto numChunkSamples = juce::jmin(chunkLength, numSamples - start);
+        auto chunk = block.getSubBlock(static_cast<size_t> (start), static_cast<size_t> (numChunkSamples));
+        
+        modulation.process(modulationSettings, transport, midiMessages, start, numChunkSamples);
+        
+        if (modulated)
+            processModulated(chunk, sidechainActive ? &sidechainBuffer : nullptr, start, chainSettings, tier);
+        else if (ladder)
+            processLadders(chunk);
+        else if (spectral)
+            processSpectral(chunk);
+        else if (! renderInParallel)
+            processChains(chunk);
+        
+        transport.ppqPosition += numChunkSamples / getSampleRate() * transport.bpm / 60.0;
+    }
+    
+    if (renderInParallel)
+        processChainsInParallel(block);
+    
+    updateLatency();
+    
+    forEachPreparedChunk(block, [this, &chainSettings](juce::dsp::AudioBlock<float>& chunk)
+    {
+        processDelays(chunk, chainSettings);
+        graphPlayer.process(chunk);
+        outputMeter.process(chunk);
+    });
+    
+    qualityGovernor.update(numSamples, startTicks, juce::Time::getHighResolutionTicks());
+}
+
+void FilterPlaygroundAudioProcessor::renderOffline(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
+{
+    auto wasNonRealtime = isNonRealtime();
+    
+    setNonRealtime(true);
+    processBlock(buffer, midiMessages);
+    setNonRealtime(wasNonRealtime);
+}
+
+//==============================================================================
+bool FilterPlaygroundAudioProcessor::hasEditor() const
+{
+    return true; // (change this to false if you choose to not supply an editor)
+}
+
+juce::AudioProcessorEditor* FilterPlaygroundAudioProcessor::createEditor()
+{
+    return new FilterPlaygroundAudioProcessorEditor (*this);
+}
+
+//==============================================================================
+void FilterPlaygroundAudioProcessor::getStateInformation (juce::MemoryBlock& destData)
+{
+    // Parameters, plus the processing graph as a child of the same tree
+    auto state = apvts.copyState();
+    state.appendChild(graphDescription.toValueTree(), nullptr);
+    
+    if (auto xml = state.createXml())
+        copyXmlToBinary(*xml, destData);
+}
+
+void FilterPlaygroundAudioProcessor::setStateInformation (const void* data, int sizeInBytes)
+{
+    auto xml = getXmlFromBinary(data, sizeInBytes);
+    
+    if (xml == nullptr || ! xml->hasTagName(apvts.state.getType()))
+        return;
+    
+    auto state = juce::ValueTree::fromXml(*xml);
+    auto graph = state.getChildWithName("Graph");
+    state.removeChild(graph, nullptr);
+    
+    apvts.replaceState(state);
+    
+    // Sessions saved before the graph was stored have none, which removes the stage
+    setProcessingGraph(FilterGraphDescription::fromValueTree(graph));
+}
+
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& apvts)
+{
+    FP_TRACE_SCOPE("getChainSettings");
+    
+    ChainSettings settings;
+    
+    settings.lowPassFreq = apvts.getRawParameterValue("LowPass Freq")->load();
+    settings.lowPassSlope = static_cast<Slope>(apvts.getRawParameterValue("LowPass Slope")->load());
+    settings.resonance = apvts.getRawParameterValue("Resonance")->load();
+    settings.filterMode = static_cast<FilterMode>(apvts.getRawParameterValue("Filter Mode")->load());
+    
+    settings.spectralMode = static_cast<SpectralMode>(apvts.getRawParameterValue("Spectral Mode")->load());
+    settings.spectralThreshold = apvts.getRawParameterValue("Spectral Threshold")->load();
+    settings.fftOrder = SpectralFilter::minOrder + static_cast<int>(apvts.getRawParameterValue("FFT Size")->load());
+    settings.fftOverlap = 2 << static_cast<int>(apvts.getRawParameterValue("FFT Overlap")->load());
+    settings.fftWindow = static_cast<SpectralWindow>(apvts.getRawParameterValue("FFT Window")->load());
+    
+    auto delayType = static_cast<int>(apvts.getRawParameterValue("Delay Type")->load());
+    settings.delayEnabled = delayType > 0;
+    settings.delayStructure = static_cast<DelayStructure>(juce::jmax(0, delayType - 1));
+    settings.delayInterpolation = static_cast<DelayInterpolation>(apvts.getRawParameterValue("Delay Interpolation")->load());
+    settings.delayFrequency = apvts.getRawParameterValue("Delay Freq")->load();
+    settings.delayGain = apvts.getRawParameterValue("Delay Gain")->load();
+    
+    settings.sidechainAmount = apvts.getRawParameterValue("Sidechain Amount")->load();
+    settings.sidechainAttack = apvts.getRawParameterValue("Sidechain Attack")->load();
+    settings.sidechainRelease = apvts.getRawParameterValue("Sidechain Release")->load();
+    settings.sidechainMode = static_cast<EnvelopeFollower::Mode>(apvts.getRawParameterValue("Sidechain Mode")->load());
+    
+    settings.qualityMode = static_cast<QualityMode>(apvts.getRawParameterValue("Quality")->load());
+    
+    return settings;
+}
+
+ModulationParameters::ModulationParameters(juce::AudioProcessorValueTreeState& apvts)
+{
+    auto find = [&apvts](const juce::String& id) { return apvts.getRawParameterValue(id); };
+    
+    lfoShape = find("LFO Shape");
+    lfoSync = find("LFO Sync");
+    lfoRate = find("LFO Rate");
+    lfoDivision = find("LFO Division");
+    
+    envAttack = find("Env Attack");
+    envDecay = find("Env Decay");
+    envSustain = find("Env Sustain");
+    envRelease = find("Env Release");
+    
+    seqDivision = find("Seq Division");
+    for( int i = 0; i < ModulationSettings::numSequencerSteps; ++i )
+        seqSteps[(size_t) i] = find("Seq Step " + juce::String(i + 1));
+    
+    for( int i = 0; i < ModulationSettings::numSlots; ++i )
+    {
+        auto prefix = "Mod " + juce::String(i + 1);
+        
+        slotSources[(size_t) i] = find(prefix + " Source");
+        slotTargets[(size_t) i] = find(prefix + " Target");
+        slotDepths[(size_t) i] = find(prefix + " Depth");
+    }
+}
+
+ModulationSettings ModulationParameters::load() const
+{
+    FP_TRACE_SCOPE("ModulationParameters::load");
+    
+    ModulationSettings settings;
+    
+    settings.lfoShape = static_cast<LfoShape>(lfoShape->load());
+    settings.lfoSync = lfoSync->load() > 0.5f;
+    settings.lfoRate = lfoRate->load();
+    settings.lfoBeats = syncDivisionBeats[static_cast<size_t>(lfoDivision->load())];
+    
+    settings.envelope.attack = envAttack->load() * 0.001f;
+    settings.envelope.decay = envDecay->load() * 0.001f;
+    settings.envelope.sustain = envSustain->load();
+    settings.envelope.release = envRelease->load() * 0.001f;
+    
+    settings.sequencerBeats = syncDivisionBeats[static_cast<size_t>(seqDivision->load())];
+    for( size_t i = 0; i < seqSteps.size(); ++i )
+        settings.sequencerSteps[i] = seqSteps[i]->load();
+    
+    for( size_t i = 0; i < settings.slots.size(); ++i )
+    {
+        settings.slots[i].source = static_cast<ModSource>(slotSources[i]->load());
+        settings.slots[i].target = static_cast<ModTarget>(slotTargets[i]->load());
+        settings.slots[i].depth = slotDepths[i]->load();
+    }
+    
+    return settings;
+}
+
+juce::AudioProcessorValueTreeState::ParameterLayout FilterPlaygroundAudioProcessor::createParameterLayout()
+{
+    juce::AudioProcessorValueTreeState::ParameterLayout layout;
+    
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("LowPass Freq",
+                                                           "LowPass Freq",
+                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
+                                                           1000.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Resonance",
+                                                           "Resonance",
+                                                           juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f),
+                                                           0.f));
+        
+    juce::StringArray stringArray;
+    for( int i = 0; i < 2; ++i )
+    {
+        juce::String str;
+        str << (6 + i*6);
+        str << " db/Oct";
+        stringArray.add(str);
+    }
+    layout.add(std::make_unique<juce::AudioParameterChoice>("LowPass Slope", "LowPass Slope", stringArray, 0));
+    
+    // Ladder is the saturating four-pole ladder, driven by LowPass Freq and Resonance.
+    // Spectral filters each STFT bin by its level, see SpectralFilter.
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Filter Mode", "Filter Mode", juce::StringArray { "Clean", "Ladder", "Spectral" }, 0));
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Spectral Mode", "Spectral Mode", juce::StringArray { "Dynamic Low-Pass", "Gate" }, 0));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Spectral Threshold",
+                                                           "Spectral Threshold",
+                                                           juce::NormalisableRange<float>(-90.f, 0.f, 0.1f, 1.f),
+                                                           -50.f));
+    
+    // Bigger FFTs resolve lower frequencies but add latency (the FFT size) and smear transients
+    layout.add(std::make_unique<juce::AudioParameterChoice>("FFT Size", "FFT Size", juce::StringArray { "256", "512", "1024", "2048", "4096" }, 2));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("FFT Overlap", "FFT Overlap", juce::StringArray { "2x", "4x", "8x" }, 1));
+    layout.add(std::make_unique<juce::AudioParameterChoice>("FFT Window", "FFT Window", juce::StringArray { "Hann", "Hamming", "Blackman-Harris" }, 0));
+    
+    // Same modules as the graph's delay nodes; Delay Freq is the comb's first peak, sampleRate / freq samples
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Delay Type", "Delay Type",
+                                                            juce::StringArray { "Off", "Comb", "Feedforward Comb", "Allpass", "Fractional Delay" }, 0));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Delay Freq",
+                                                           "Delay Freq",
+                                                           juce::NormalisableRange<float>(minimumDelayFrequency, 5000.f, 0.1f, 0.3f),
+                                                           200.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Delay Gain",
+                                                           "Delay Gain",
+                                                           juce::NormalisableRange<float>(-0.99f, 0.99f, 0.01f, 1.f),
+                                                           0.5f));
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Delay Interpolation", "Delay Interpolation",
+                                                            juce::StringArray { "None", "Linear", "Lagrange", "Thiran" }, 0));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Sidechain Amount",
+                                                           "Sidechain Amount",
+                                                           juce::NormalisableRange<float>(-8.f, 8.f, 0.01f, 1.f),
+                                                           0.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Sidechain Attack",
+                                                           "Sidechain Attack",
+                                                           juce::NormalisableRange<float>(0.1f, 200.f, 0.1f, 0.3f),
+                                                           5.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Sidechain Release",
+                                                           "Sidechain Release",
+                                                           juce::NormalisableRange<float>(1.f, 2000.f, 1.f, 0.3f),
+                                                           150.f));
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Sidechain Mode", "Sidechain Mode", juce::StringArray { "Peak", "RMS" }, 0));
+    
+    // Adaptive steps down under CPU pressure and back up once there's headroom, see QualityGovernor
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Quality", "Quality", juce::StringArray { "Adaptive", "Full", "Reduced", "Minimum" }, 1));
+    
+    //==============================================================================
+    // Modulation sources and matrix
+    juce::StringArray divisions { "1/16", "1/8", "1/4", "1/2", "1 Bar", "2 Bars" };
+    
+    auto addFloat = [&layout](const juce::String& id, juce::NormalisableRange<float> range, float defaultValue)
+    {
+        layout.add(std::make_unique<juce::AudioParameterFloat>(id, id, range, defaultValue));
+    };
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("LFO Shape", "LFO Shape", juce::StringArray { "Sine", "Triangle", "Saw", "Square" }, 0));
+    layout.add(std::make_unique<juce::AudioParameterBool>("LFO Sync", "LFO Sync", false));
+    addFloat("LFO Rate", juce::NormalisableRange<float>(0.01f, 20.f, 0.01f, 0.3f), 1.f);
+    layout.add(std::make_unique<juce::AudioParameterChoice>("LFO Division", "LFO Division", divisions, 2));
+    
+    addFloat("Env Attack", juce::NormalisableRange<float>(0.f, 5000.f, 1.f, 0.3f), 10.f);
+    addFloat("Env Decay", juce::NormalisableRange<float>(0.f, 5000.f, 1.f, 0.3f), 200.f);
+    addFloat("Env Sustain", juce::NormalisableRange<float>(0.f, 1.f, 0.01f, 1.f), 0.5f);
+    addFloat("Env Release", juce::NormalisableRange<float>(0.f, 5000.f, 1.f, 0.3f), 300.f);
+    
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Seq Division", "Seq Division", divisions, 0));
+    for( int i = 0; i < ModulationSettings::numSequencerSteps; ++i )
+        addFloat("Seq Step " + juce::String(i + 1), juce::NormalisableRange<float>(-1.f, 1.f, 0.01f, 1.f), 0.f);
+    
+    for( int i = 0; i < ModulationSettings::numSlots; ++i )
+    {
+        auto prefix = "Mod " + juce::String(i + 1);
+        
+        layout.add(std::make_unique<juce::AudioParameterChoice>(prefix + " Source", prefix + " Source",
+                                                                juce::StringArray { "None", "LFO", "Envelope", "Step Seq" }, 0));
+        layout.add(std::make_unique<juce::AudioParameterChoice>(prefix + " Target", prefix + " Target",
+                                                                juce::StringArray { "Cutoff", "Resonance" }, 0));
+        addFloat(prefix + " Depth", juce::NormalisableRange<float>(-1.f, 1.f, 0.01f, 1.f), 0.f);
+    }
+
+    return layout;
+}
+
+
+//==============================================================================
+// This creates new instances of the plugin..
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new FilterPlaygroundAudioProcessor();
+}
@@ -1,114 +1,364 @@
-/*
-  ==============================================================================
-
-    This file contains the basic framework code for a JUCE plugin processor.
-
-  ==============================================================================
-*/
-
-#pragma once
-
-#include <JuceHeader.h>
-#include "Engine/CustomFilter.h"
-
-enum Slope
-{
-    Slope_6
-};
-struct ChainSettings
-{
-    float lowPassFreq {0};
-    Slope lowPassSlope {Slope::Slope_6};
-    float resonance {1.f};
-};
-
-ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& aptvs);
-
-//==============================================================================
-/**
-*/
-class FilterPlaygroundAudioProcessor  : public juce::AudioProcessor
-{
-public:
-    //==============================================================================
-    FilterPlaygroundAudioProcessor();
-    ~FilterPlaygroundAudioProcessor() override;
-
-    //==============================================================================
-    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
-    void releaseResources() override;
-
-   #ifndef JucePlugin_PreferredChannelConfigurations
-    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
-   #endif
-
-    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
-
-    //==============================================================================
-    juce::AudioProcessorEditor* createEditor() override;
-    bool hasEditor() const override;
-
-    //==============================================================================
-    const juce::String getName() const override;
-
-    bool acceptsMidi() const override;
-    bool producesMidi() const override;
-    bool isMidiEffect() const override;
-    double getTailLengthSeconds() const override;
-
-    //==============================================================================
-    int getNumPrograms() override;
-    int getCurrentProgram() override;
-    void setCurrentProgram (int index) override;
-    const juce::String getProgramName (int index) override;
-    void changeProgramName (int index, const juce::String& newName) override;
-
-    //==============================================================================
-    void getStateInformation (juce::MemoryBlock& destData) override;
-    void setStateInformation (const void* data, int sizeInBytes) override;
-
-    // Coordinatees gui components with dsp variables
-    juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
-    
-    juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
-    
-    CustomFilter cFilter;
-
-private:
-    
-    // Seems to me like we can create an IIR filter and pass it to a processor chain.
-    // To change the behavior of the IIR filter, pass the custom coefficients in processBlock
-    // as per https://github.com/juce-framework/JUCE/blob/2b16c1b94c90d0db3072f6dc9da481a9484d0435/modules/juce_dsp/processors/juce_IIRFilter.h#L313
-    using Filter = juce::dsp::IIR::Filter<float>;
-    
-    // Based on https://youtu.be/i_Iq4_Kd7Rc?t=2008
-    //Processor chain, 1 filter for now.
-
-    using CutFilter = juce::dsp::ProcessorChain<Filter>;
-    using MonoChain = juce::dsp::ProcessorChain<CutFilter>;
-    MonoChain leftChain, rightChain;
-    
-    //==============================================================================
-    
-    enum ChainPositions
-    {
-        LowPass
-    };
-    using Coefficients = Filter::CoefficientsPtr;
-    static void updateCoefficents(Coefficients& old, const Coefficients& replacements);
-    
-    template<int Index, typename ChainType, typename CoefficientType>
-    void update(ChainType& chain, const CoefficientType& coefficients);
-    
-    void updateFilters();
-    
-    template<typename ChainType, typename CoefficientType>
-    void updateFilter(ChainType& type,
-                         const CoefficientType& coefficients,
-                         const Slope& slope );
-    
-    void updateLowPassFilter(const ChainSettings& chainSettings);
-
-
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FilterPlaygroundAudioProcessor)
-};
+/*
+  ==============================================================================
+
+    This file contains the basic framework code for a JUCE plugin processor.
+
+  ==============================================================================
+*/
+
+#pragma once
+
+#include <JuceHeader.h>
+#include "Engine/CustomFilter.h"
+#include "Engine/OnePoleTPT.h"
+#include "Engine/ParallelOnePole.h"
+#include "Engine/WorkerPool.h"
+#include "Engine/FilterGraph.h"
+#include "Engine/DelayLine.h"
+#include "Engine/EnvelopeFollower.h"
+#include "Engine/Modulation.h"
+#include "Engine/Trace.h"
+#include "Engine/QualityGovernor.h"
+#include "Engine/DspSnapshot.h"
+#include "Engine/LevelMeter.h"
+#include "Engine/DspArena.h"
+#include "Engine/FilterKernels.h"
+#include "Engine/LadderFilter.h"
+#include "Engine/SpectralFilter.h"
+
+enum Slope
+{
+    Slope_6
+};
+
+enum class FilterMode
+{
+    Clean,      // first-order TPT low-pass
+    Ladder,     // saturating four-pole ladder, uses Resonance
+    Spectral    // STFT per-bin gain, uses the Spectral and FFT parameters
+};
+
+struct ChainSettings
+{
+    float lowPassFreq {0};
+    Slope lowPassSlope {Slope::Slope_6};
+    float resonance {1.f};
+    FilterMode filterMode {FilterMode::Clean};
+    
+    SpectralMode spectralMode {SpectralMode::DynamicLowPass};
+    float spectralThreshold {-50.f};    // dBFS per bin
+    int fftOrder {10};
+    int fftOverlap {4};
+    SpectralWindow fftWindow {SpectralWindow::Hann};
+    
+    // Delay stage after the filter, the graph's delay modules on two parameters: Delay Freq sets
+    // the delay to sampleRate / freq, so a comb's first peak sits on it
+    bool delayEnabled {false};
+    DelayStructure delayStructure {DelayStructure::FeedbackComb};
+    DelayInterpolation delayInterpolation {DelayInterpolation::None};
+    float delayFrequency {200.f};
+    float delayGain {0.5f};
+    
+    // Sidechain envelope -> cutoff, amount is in octaves at full scale
+    float sidechainAmount {0};
+    float sidechainAttack {5.f};
+    float sidechainRelease {150.f};
+    EnvelopeFollower::Mode sidechainMode {EnvelopeFollower::Mode::Peak};
+    
+    QualityMode qualityMode {QualityMode::Full};
+};
+
+ChainSettings getChainSettings(juce::AudioProcessorValueTreeState& aptvs);
+
+// The modulation section has too many parameters to look up by name every block,
+// so the raw value pointers are resolved once and read from here
+struct ModulationParameters
+{
+    explicit ModulationParameters(juce::AudioProcessorValueTreeState& apvts);
+    ModulationSettings load() const;
+    
+    std::atomic<float>* lfoShape;
+    std::atomic<float>* lfoSync;
+    std::atomic<float>* lfoRate;
+    std::atomic<float>* lfoDivision;
+    
+    std::atomic<float>* envAttack;
+    std::atomic<float>* envDecay;
+    std::atomic<float>* envSustain;
+    std::atomic<float>* envRelease;
+    
+    std::atomic<float>* seqDivision;
+    std::array<std::atomic<float>*, ModulationSettings::numSequencerSteps> seqSteps;
+    
+    std::array<std::atomic<float>*, ModulationSettings::numSlots> slotSources;
+    std::array<std::atomic<float>*, ModulationSettings::numSlots> slotTargets;
+    std::array<std::atomic<float>*, ModulationSettings::numSlots> slotDepths;
+};
+
+//==============================================================================
+/**
+*/
+class FilterPlaygroundAudioProcessor  : public juce::AudioProcessor,
+                                        private juce::AsyncUpdater
+{
+public:
+    //==============================================================================
+    FilterPlaygroundAudioProcessor();
+    ~FilterPlaygroundAudioProcessor() override;
+
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override;
+    void releaseResources() override;
+
+   #ifndef JucePlugin_PreferredChannelConfigurations
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override;
+   #endif
+
+    void processBlock (juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+
+    //==============================================================================
+    juce::AudioProcessorEditor* createEditor() override;
+    bool hasEditor() const override;
+
+    //==============================================================================
+    const juce::String getName() const override;
+
+    bool acceptsMidi() const override;
+    bool producesMidi() const override;
+    bool isMidiEffect() const override;
+    double getTailLengthSeconds() const override;
+
+    //==============================================================================
+    int getNumPrograms() override;
+    int getCurrentProgram() override;
+    void setCurrentProgram (int index) override;
+    const juce::String getProgramName (int index) override;
+    void changeProgramName (int index, const juce::String& newName) override;
+
+    //==============================================================================
+    void getStateInformation (juce::MemoryBlock& destData) override;
+    void setStateInformation (const void* data, int sizeInBytes) override;
+
+    // Coordinatees gui components with dsp variables
+    juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+    
+    juce::AudioProcessorValueTreeState apvts {*this, nullptr, "Parameters", createParameterLayout()};
+    
+    CustomFilter cFilter;
+    
+    // Message thread. Compiles the graph and crossfades to it; it runs after the LowPass stage.
+    // An empty description removes the stage.
+    void setProcessingGraph(const FilterGraphDescription& description);
+    
+    // Offline renders (bounces, the Tools render command): the whole buffer in one call, marked
+    // non-realtime so a long stretch of the settled clean low-pass is split in time across the
+    // shared worker pool (ParallelOnePole). Everything else still runs in prepared-size chunks.
+    // Call it where processBlock would be called, after prepareToPlay.
+    void renderOffline(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages);
+    
+    // Writes the recorded processBlock/worker timeline as Chrome trace JSON (chrome://tracing,
+    // ui.perfetto.dev). Only records in builds with FILTERPLAYGROUND_TRACE=1, returns false otherwise.
+    bool exportTimelineTrace(const juce::File& file) const;
+    
+    // Tier the "Quality" parameter (or the adaptive policy) currently runs at, this instance's
+    // smoothed processBlock time over the block's duration, and the whole session's load the
+    // adaptive policy goes by (see QualityPolicy). Safe from any thread.
+    QualityTier getQualityTier() const noexcept { return qualityGovernor.getTier(); }
+    float getProcessingLoad() const noexcept { return qualityGovernor.getLoad(); }
+    float getSessionLoad() const noexcept { return qualityGovernor.getSessionLoad(); }
+    const QualityPolicy& getQualityPolicy() const noexcept { return qualityGovernor.getPolicy(); }
+    
+    // Main bus levels going into and coming out of processBlock. Safe from any thread; the meters
+    // only run while something keeps reading them.
+    LevelReadings getInputLevels() const noexcept { return inputMeter.getReadings(); }
+    LevelReadings getOutputLevels() const noexcept { return outputMeter.getReadings(); }
+    
+    // Memory this instance holds for processing: the processor object itself (filter states,
+    // smoothers), the arena prepareToPlay sized for its buffers (modulation, meters, the graph
+    // crossfade and the delay lines), and what lives outside it: the STFT layout Spectral mode
+    // builds for its FFT size, and the compiled processing graph. Safe from any thread.
+    struct DspFootprint
+    {
+        size_t instanceBytes;
+        size_t arenaBytes;
+        size_t spectralBytes;
+        size_t graphBytes;
+        
+        size_t getTotalBytes() const noexcept { return instanceBytes + arenaBytes + spectralBytes + graphBytes; }
+    };
+    
+    DspFootprint getDspFootprint() const noexcept;
+    
+    // Instruction set the filter kernels were picked for in prepareToPlay (CPUID, or the
+    // FilterKernelDispatch override)
+    const FilterKernels& getFilterKernels() const noexcept { return *filterKernels; }
+    
+    // DSP state (filter memories, smoothers, modulation phases, graph memories) as one flat blob,
+    // for resuming chunked offline renders and restoring warm state after a seek.
+    // getDspStateSize() is for preallocating on the message thread after prepareToPlay,
+    // setProcessingGraph or a change of STFT layout. Capture and restore never allocate or lock;
+    // call them on the audio thread between blocks, or while processing is stopped.
+    size_t getDspStateSize() const;
+    size_t captureDspState(void* dest, size_t capacity) const noexcept;    // bytes written, 0 if it didn't fit
+    bool restoreDspState(const void* source, size_t size) noexcept;         // false, and nothing changed, if it doesn't match
+
+private:
+    // Tables, windows and FFT plans shared by every instance in the process
+    juce::SharedResourcePointer<SharedDspResources> sharedResources;
+    
+    // Background threads shared by every instance in the process
+    juce::SharedResourcePointer<WorkerPool> workers;
+    
+    // The slot used to hold a juce::dsp::IIR::Filter fed with CustomFilter's coefficients.
+    // It now runs the dedicated first-order TPT kernel, CustomFilter still designs its alpha.
+    using Filter = OnePoleLowPass;
+    
+    // Based on https://youtu.be/i_Iq4_Kd7Rc?t=2008
+    //Processor chain, 1 filter for now.
+
+    using CutFilter = juce::dsp::ProcessorChain<Filter>;
+    using MonoChain = juce::dsp::ProcessorChain<CutFilter>;
+    MonoChain leftChain, rightChain;
+    const FilterKernels* filterKernels {&FilterKernelDispatch::getCompiledKernels().front()};
+    
+    //==============================================================================
+    
+    enum ChainPositions
+    {
+        LowPass
+    };
+    template<int Index, typename ChainType, typename CoefficientType>
+    void update(ChainType& chain, const CoefficientType& coefficients);
+    
+    void updateFilters();
+    
+    template<typename ChainType, typename CoefficientType>
+    void updateFilter(ChainType& type,
+                         const CoefficientType& coefficients,
+                         const Slope& slope );
+    
+    void updateLowPassFilter(const ChainSettings& chainSettings);
+    
+    //==============================================================================
+    // A new cutoff is one lookup in the shared alpha table, cheap enough to do inline at the top
+    // of the block it arrives in
+    void updateLowPassCutoff(float cutoff);
+    void setLowPassAlpha(float alpha);
+    void setLowPassTargetAlpha(float alpha);
+    
+    void processChains(juce::dsp::AudioBlock<float>& block);
+    
+    // Identical input channels with the two chains in the same state only run the left chain
+    bool isDualMono(const juce::dsp::AudioBlock<float>& block) const noexcept;
+    void copyLeftToRight(juce::dsp::AudioBlock<float>& block) noexcept;
+    
+    // Offline bounces with long blocks split the low-pass across the worker pool, see ParallelOnePole
+    bool canProcessChainsInParallel(const juce::dsp::AudioBlock<float>& block);
+    void processChainsInParallel(juce::dsp::AudioBlock<float>& block);
+    
+    //==============================================================================
+    // Ladder mode runs these instead of the chains. Cutoff and resonance are set per block, or per
+    // coefficient update when modulated; the tier picks whether the saturator is antialiased.
+    void setLadderParameters(float cutoff, float resonance, QualityTier tier) noexcept;
+    void processLadders(juce::dsp::AudioBlock<float>& block);
+    
+    LadderFilter leftLadder, rightLadder;
+    FilterMode activeFilterMode {FilterMode::Clean};
+    
+    //==============================================================================
+    // Spectral mode runs the STFT filter instead, with its cutoff following LowPass Freq (and
+    // modulation) like the other modes. It delays the output by the running layout's FFT size; the
+    // audio thread notices when that changes and the message thread passes it on to the host.
+    void setSpectralParameters(const ChainSettings& chainSettings, float cutoff) noexcept;
+    
+    // The STFT layout the settings call for, none outside Spectral mode. Requested on the audio
+    // thread and built by spectralLayoutJob on the worker pool while the old layout keeps running;
+    // the lock only keeps the job and an offline render's first layout apart.
+    static SpectralLayoutSettings getSpectralLayout(const ChainSettings& chainSettings) noexcept;
+    void requestSpectralLayout(const ChainSettings& chainSettings);
+    void buildSpectralLayout();
+    
+    struct SpectralLayoutJob : public WorkerJob
+    {
+        explicit SpectralLayoutJob(FilterPlaygroundAudioProcessor& p) : processor(p) {}
+        void run() override { processor.buildSpectralLayout(); }
+        
+        FilterPlaygroundAudioProcessor& processor;
+    };
+    
+    std::atomic<int> requestedSpectralLayout {0};
+    int builtSpectralLayout {0};
+    juce::CriticalSection spectralLayoutLock;
+    SpectralLayoutJob spectralLayoutJob {*this};
+    
+    int getSpectralLatency() const noexcept;
+    void processSpectral(juce::dsp::AudioBlock<float>& block);
+    void updateLatency() noexcept;
+    void handleAsyncUpdate() override;
+    
+    SpectralFilter spectralFilter;
+    int requestedLatency {0};
+    std::atomic<int> pendingLatency {0};
+    
+    //==============================================================================
+    // Delay stage, runs after whichever filter mode is active. The lines are sized in prepareToPlay
+    // for a period of the lowest Delay Freq.
+    static constexpr float minimumDelayFrequency = 20.f;
+    
+    void processDelays(juce::dsp::AudioBlock<float>& block, const ChainSettings& chainSettings);
+    
+    DelayLineFilter leftDelay, rightDelay;
+    bool delayActive {false};
+    
+    //==============================================================================
+    // Sidechain envelope and the modulation matrix drive the cutoff at control rate inside the block
+    static constexpr int controlInterval = 32;
+    
+    bool isSidechainConnected() const;
+    ModulationEngine::Transport getTransport();
+    void processModulated(juce::dsp::AudioBlock<float>& block,
+                          const juce::AudioBuffer<float>* sidechain,
+                          int startSample,
+                          const ChainSettings& chainSettings,
+                          QualityTier tier);
+    
+    EnvelopeFollower envelopeFollower;
+    ModulationEngine modulation;
+    ModulationParameters modulationParameters {apvts};
+    bool lowPassModulated {false};
+    QualityTier modulatedTier {QualityTier::Full};
+    
+    QualityGovernor qualityGovernor;
+    LevelMeter inputMeter, outputMeter;
+    
+    // The meters and the graph crossfade are sized for prepareToPlay's block, longer (offline)
+    // blocks go through them a chunk of that size at a time
+    int preparedBlockSize {0};
+    
+    template <typename Stage>
+    void forEachPreparedChunk(juce::dsp::AudioBlock<float>& block, Stage&& stage)
+    {
+        auto numSamples = block.getNumSamples();
+        auto chunkLength = (size_t) juce::jmax(1, preparedBlockSize);
+        
+        for( size_t start = 0; start < numSamples; start += chunkLength )
+        {
+            auto chunk = block.getSubBlock(start, juce::jmin(chunkLength, numSamples - start));
+            stage(chunk);
+        }
+    }
+    
+    // Every buffer sized in prepareToPlay, one block per instance
+    DspArena dspArena;
+    
+    //==============================================================================
+    std::unique_ptr<CompiledFilterGraph> compileProcessingGraph() const;
+    
+    FilterGraphDescription graphDescription;
+    FilterGraphPlayer graphPlayer;
+    
+    float appliedCutoff {-1.f};
+
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FilterPlaygroundAudioProcessor)
+};
@@ -0,0 +1,470 @@
+/*
+  ==============================================================================
+
+    CharacterizeCommand.cpp
+    Created: 23 Oct 2022 3:48:19pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "../../Source/Engine/CustomFilter.h"
+#include "../../Source/Engine/FilterKernels.h"
+#include "../../Source/Engine/LadderFilter.h"
+#include "../../Source/Engine/WorkerPool.h"
+#include <complex>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    // The plugin's "Filter Mode" choices. The 6 dB one-pole and the 24 dB ladder are the two
+    // slopes the engine actually has, so they're the slope axis of the grid.
+    enum class Mode
+    {
+        Clean,
+        Ladder
+    };
+
+    struct GridPoint
+    {
+        Mode mode;
+        double sampleRate;
+        float cutoff;
+        float resonance;    // the Resonance parameter's value, 0.1 to 10
+    };
+
+    enum class Verdict
+    {
+        Ok,
+        Deviates,       // settled, but off the analytic response by more than the tolerance
+        Unsettled,      // still ringing at the end of the window (self-oscillation, or just slow)
+        Unstable        // growing, or not finite
+    };
+
+    const char* getVerdictName(Verdict verdict)
+    {
+        switch (verdict)
+        {
+            case Verdict::Ok:        return "ok";
+            case Verdict::Deviates:  return "deviates";
+            case Verdict::Unsettled: return "unsettled";
+            case Verdict::Unstable:  return "unstable";
+        }
+
+        return "";
+    }
+
+    struct PointResult
+    {
+        float dcGain;               // where the step response ends up
+        float overshootPercent;
+        float peakDb, peakHz;       // largest magnitude on the evaluation grid
+        float maxMagnitudeError;    // dB, against the analytic response
+        float maxPhaseError;        // degrees, where the response is above -60 dB
+        Verdict verdict;
+    };
+
+    struct CharacterizeOptions
+    {
+        int numCutoffs {64};
+        int numResonances {8};
+        std::vector<double> sampleRates { 44100.0, 48000.0, 96000.0, 192000.0 };
+        int order {15};             // 2^order samples of impulse and step response per point
+        int numFrequencies {256};   // log-spaced magnitude/phase evaluation points
+        float toleranceDb {0.1f};
+        float toleranceDegrees {1.f};
+        int numWorkers {juce::jmax(1, juce::SystemStats::getNumCpus() - 1)};
+        juce::File csvFile, responsesFile;
+    };
+
+    // Small enough that the ladder's saturator stays in its linear region, so the analytic
+    // linear response is the right reference
+    constexpr float testLevel = 1.0e-3f;
+
+    // Renders the impulse response of one grid point through the same engine pieces the processor
+    // runs: CustomFilter's alpha table into the dispatched one-pole kernel, or the ladder with the
+    // processor's resonance mapping and antialiasing.
+    void renderImpulse(const GridPoint& point, SharedDspResources& resources, float* out, int numSamples)
+    {
+        std::fill(out, out + numSamples, 0.f);
+        out[0] = testLevel;
+
+        constexpr int blockSize = 512;
+
+        if (point.mode == Mode::Clean)
+        {
+            CustomFilter design;
+            design.prepare(resources, point.sampleRate);
+
+            OnePoleLowPass lowPass;
+            auto& kernels = FilterKernelDispatch::select();
+            lowPass.setKernels(kernels.process, kernels.processRamp);
+            lowPass.setAlpha(design.getAlpha(point.sampleRate, point.cutoff));
+
+            for( int start = 0; start < numSamples; start += blockSize )
+            {
+                float* channel = out + start;
+                juce::dsp::AudioBlock<float> block (&channel, 1, (size_t) juce::jmin(blockSize, numSamples - start));
+                lowPass.process(juce::dsp::ProcessContextReplacing<float> (block));
+            }
+        }
+        else
+        {
+            LadderFilter ladder;
+            ladder.prepare(point.sampleRate);
+            ladder.setAntialiasing(LadderAntialiasing::FirstOrder);
+            ladder.setParameters(point.cutoff, LadderFilter::getResonanceAmount(point.resonance));
+
+            for( int start = 0; start < numSamples; start += blockSize )
+                ladder.process(out + start, out + start, juce::jmin(blockSize, numSamples - start));
+        }
+    }
+
+    // The continuous-time design mapped through the bilinear transform, in double: the one-pole
+    // alpha (1 + z^-1) / (1 + (2 alpha - 1) z^-1), and the linearised ladder
+    // (1 + k) H1^4 / (1 + k H1^4) with H1 = g (1 + z^-1) / ((1 + g) - (1 - g) z^-1).
+    std::complex<double> getAnalyticResponse(const GridPoint& point, double frequency)
+    {
+        auto maxCutoff = point.mode == Mode::Clean ? 0.5 * point.sampleRate : 0.49 * point.sampleRate;
+        auto cutoff = juce::jlimit(20.0, maxCutoff, static_cast<double> (point.cutoff));
+        auto g = std::tan(juce::MathConstants<double>::pi * cutoff / point.sampleRate);
+        auto zInverse = std::polar(1.0, -2.0 * juce::MathConstants<double>::pi * frequency / point.sampleRate);
+
+        if (point.mode == Mode::Clean)
+        {
+            auto alpha = g / (1.0 + g);
+            return alpha * (1.0 + zInverse) / (1.0 + (2.0 * alpha - 1.0) * zInverse);
+        }
+
+        auto k = LadderFilter::maxFeedback * LadderFilter::getResonanceAmount(point.resonance);
+        auto stage = g * (1.0 + zInverse) / ((1.0 + g) - (1.0 - g) * zInverse);
+        auto fourStages = stage * stage * stage * stage;
+
+        return (1.0 + k) * fourStages / (1.0 + k * fourStages);
+    }
+
+    double toDecibels(double gain) { return 20.0 * std::log10(juce::jmax(gain, 1.0e-12)); }
+
+    // Everything one task needs, sized once per task so the inner loop doesn't allocate
+    struct Workspace
+    {
+        explicit Workspace(int order)
+            : impulse ((size_t) 2 << order) {}
+
+        std::vector<float> impulse;     // twice the length, the FFT works in place on it
+    };
+
+    PointResult characterize(const GridPoint& point, SharedDspResources& resources, const juce::dsp::FFT& fft,
+                             const CharacterizeOptions& options, Workspace& workspace, float* responseOut)
+    {
+        PointResult result {};
+        const int size = fft.getSize();
+        auto* impulse = workspace.impulse.data();
+
+        renderImpulse(point, resources, impulse, size);
+
+        // Stability and settling from the impulse response: compare the last eighth of the window
+        // with the one before it, and the end of it with the peak
+        float peak = 0, previousEighth = 0, lastEighth = 0;
+        bool finite = true;
+
+        for( int i = 0; i < size; ++i )
+        {
+            auto magnitude = std::abs(impulse[i]);
+            finite = finite && std::isfinite(impulse[i]);
+            peak = juce::jmax(peak, magnitude);
+
+            if (i >= size - size / 8)
+                lastEighth = juce::jmax(lastEighth, magnitude);
+            else if (i >= size - size / 4)
+                previousEighth = juce::jmax(previousEighth, magnitude);
+        }
+
+        auto growing = lastEighth > previousEighth * 1.01f && lastEighth > peak * 1.0e-6f;
+        auto settled = lastEighth <= peak * 1.0e-6f;
+
+        // At the test level both filters are linear, so the step response is the running sum of
+        // the impulse response and doesn't need a second render
+        double stepValue = 0, stepPeak = 0;
+
+        for( int i = 0; i < size; ++i )
+        {
+            stepValue += impulse[i];
+            stepPeak = juce::jmax(stepPeak, stepValue);
+        }
+
+        result.dcGain = static_cast<float> (stepValue / testLevel);
+        result.overshootPercent = stepValue > 0 ? static_cast<float> (100.0 * (stepPeak - stepValue) / stepValue) : 0.f;
+
+        if (! finite || growing)
+        {
+            result.verdict = Verdict::Unstable;
+            return result;
+        }
+
+        fft.performRealOnlyForwardTransform(impulse);
+
+        auto nyquistBin = size / 2;
+        auto lowest = 10.0, highest = 0.49 * point.sampleRate;
+        result.peakDb = -1000.f;
+
+        for( int f = 0; f < options.numFrequencies; ++f )
+        {
+            // Log-spaced, snapped to the nearest bin so no interpolation error creeps in
+            auto wanted = lowest * std::pow(highest / lowest, f / (double) (options.numFrequencies - 1));
+            auto bin = juce::jlimit(1, nyquistBin, static_cast<int> (std::round(wanted * size / point.sampleRate)));
+            auto frequency = bin * point.sampleRate / size;
+
+            std::complex<double> measured (impulse[2 * bin], impulse[2 * bin + 1]);
+            measured /= testLevel;
+
+            auto analytic = getAnalyticResponse(point, frequency);
+            auto measuredDb = toDecibels(std::abs(measured));
+            auto analyticDb = toDecibels(std::abs(analytic));
+
+            if (responseOut != nullptr)
+            {
+                responseOut[2 * f] = static_cast<float> (measuredDb);
+                responseOut[2 * f + 1] = static_cast<float> (std::arg(measured) * 180.0 / juce::MathConstants<double>::pi);
+            }
+
+            if (measuredDb > result.peakDb)
+            {
+                result.peakDb = static_cast<float> (measuredDb);
+                result.peakHz = static_cast<float> (frequency);
+            }
+
+            // Below -100 dB it's float rounding being compared, not the filter
+            if (analyticDb > -100.0)
+                result.maxMagnitudeError = juce::jmax(result.maxMagnitudeError, static_cast<float> (std::abs(measuredDb - analyticDb)));
+
+            if (analyticDb > -60.0)
+            {
+                auto phaseError = std::abs(std::arg(measured / analytic)) * 180.0 / juce::MathConstants<double>::pi;
+                result.maxPhaseError = juce::jmax(result.maxPhaseError, static_cast<float> (phaseError));
+            }
+        }
+
+        if (! settled)
+            result.verdict = Verdict::Unsettled;
+        else if (result.maxMagnitudeError > options.toleranceDb || result.maxPhaseError > options.toleranceDegrees)
+            result.verdict = Verdict::Deviates;
+        else
+            result.verdict = Verdict::Ok;
+
+        return result;
+    }
+
+    CharacterizeOptions parseOptions(const juce::ArgumentList& args)
+    {
+        CharacterizeOptions options;
+
+        auto intOption = [&args](const char* name, int defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getIntValue();
+        };
+
+        options.numCutoffs = intOption("--cutoffs", options.numCutoffs);
+        options.numResonances = intOption("--resonances", options.numResonances);
+        options.order = intOption("--order", options.order);
+        options.numFrequencies = intOption("--frequencies", options.numFrequencies);
+        options.numWorkers = intOption("--workers", options.numWorkers);
+
+        auto rates = args.getValueForOption("--rates");
+        if (rates.isNotEmpty())
+        {
+            options.sampleRates.clear();
+
+            for( auto& rate : juce::StringArray::fromTokens(rates, ",", {}) )
+                options.sampleRates.push_back(rate.getDoubleValue());
+        }
+
+        auto tolerance = args.getValueForOption("--tolerance");
+        if (tolerance.isNotEmpty())
+            options.toleranceDb = tolerance.getFloatValue();
+
+        auto csv = args.getValueForOption("--csv");
+        if (csv.isNotEmpty())
+            options.csvFile = juce::File::getCurrentWorkingDirectory().getChildFile(csv);
+
+        auto responses = args.getValueForOption("--responses");
+        if (responses.isNotEmpty())
+            options.responsesFile = juce::File::getCurrentWorkingDirectory().getChildFile(responses);
+
+        if (options.numCutoffs < 2 || options.numResonances < 1 || options.numFrequencies < 2 || options.numWorkers < 1)
+            juce::ConsoleApplication::fail("need at least 2 cutoffs, 1 resonance, 2 frequencies and 1 worker");
+
+        if (options.order < 10 || options.order > 18)
+            juce::ConsoleApplication::fail("order must be between 10 and 18");
+
+        for( auto rate : options.sampleRates )
+            if (rate < 8000)
+                juce::ConsoleApplication::fail("sample rates must be at least 8000");
+
+        return options;
+    }
+
+    // Cutoffs log-spaced from 20 Hz to the lower of 20 kHz and 0.45 fs, resonance linear over the
+    // parameter's range. The clean low-pass has no resonance, it gets one point per cutoff.
+    std::vector<GridPoint> makeGrid(const CharacterizeOptions& options)
+    {
+        std::vector<GridPoint> grid;
+
+        for( auto rate : options.sampleRates )
+        {
+            auto maxCutoff = juce::jmin(20000.0, 0.45 * rate);
+
+            for( int c = 0; c < options.numCutoffs; ++c )
+            {
+                auto cutoff = static_cast<float> (20.0 * std::pow(maxCutoff / 20.0, c / (double) (options.numCutoffs - 1)));
+                grid.push_back({ Mode::Clean, rate, cutoff, 0.1f });
+
+                for( int r = 0; r < options.numResonances; ++r )
+                {
+                    auto resonance = options.numResonances > 1 ? 0.1f + 9.9f * r / (float) (options.numResonances - 1) : 0.1f;
+                    grid.push_back({ Mode::Ladder, rate, cutoff, resonance });
+                }
+            }
+        }
+
+        return grid;
+    }
+
+    // Responses file: a small header, the evaluation grid, then per point its parameters and
+    // (magnitude dB, phase degrees) pairs as little-endian float32
+    void writeResponses(const CharacterizeOptions& options, const std::vector<GridPoint>& grid, const std::vector<float>& responses)
+    {
+        options.responsesFile.deleteFile();
+        juce::FileOutputStream out (options.responsesFile);
+
+        if (! out.openedOk())
+            juce::ConsoleApplication::fail("can't write " + options.responsesFile.getFullPathName());
+
+        out.write("FPCH", 4);
+        out.writeInt(1);    // version
+        out.writeInt(static_cast<int> (grid.size()));
+        out.writeInt(options.numFrequencies);
+
+        auto valuesPerPoint = 2 * (size_t) options.numFrequencies;
+
+        for( size_t i = 0; i < grid.size(); ++i )
+        {
+            out.writeInt(static_cast<int> (grid[i].mode));
+            out.writeFloat(static_cast<float> (grid[i].sampleRate));
+            out.writeFloat(grid[i].cutoff);
+            out.writeFloat(grid[i].resonance);
+            out.write(responses.data() + i * valuesPerPoint, valuesPerPoint * sizeof(float));
+        }
+    }
+
+    void runCharacterize(const juce::ArgumentList& args)
+    {
+        auto options = parseOptions(args);
+        auto grid = makeGrid(options);
+
+        juce::SharedResourcePointer<SharedDspResources> resources;
+
+        // Build the alpha tables up front so the workers only ever look them up
+        for( auto rate : options.sampleRates )
+            resources->getOnePoleAlphaTable(rate);
+
+        juce::dsp::FFT fft (options.order);
+        WorkerPool pool (options.numWorkers, false);
+
+        std::vector<PointResult> results (grid.size());
+        std::vector<float> responses (options.responsesFile != juce::File() ? grid.size() * 2 * (size_t) options.numFrequencies : 0);
+
+        std::cout << "characterize: " << grid.size() << " grid points (" << options.numCutoffs << " cutoffs x "
+                  << (options.numResonances + 1) << " mode/resonance x " << options.sampleRates.size() << " rates), "
+                  << (1 << options.order) << "-sample responses, " << pool.getNumWorkers() + 1 << " threads, "
+                  << FilterKernelDispatch::select().name << " kernels" << std::endl;
+
+        auto start = juce::Time::getMillisecondCounterHiRes();
+
+        // Points are independent, so they're handed out in batches: one workspace per batch and
+        // few enough tasks that claiming them costs nothing
+        constexpr int pointsPerTask = 16;
+        auto numTasks = static_cast<int> ((grid.size() + pointsPerTask - 1) / pointsPerTask);
+
+        pool.parallelFor(numTasks, [&](int task)
+        {
+            Workspace workspace (options.order);
+
+            for( auto i = (size_t) task * pointsPerTask; i < juce::jmin(grid.size(), (size_t) (task + 1) * pointsPerTask); ++i )
+                results[i] = characterize(grid[i], *resources, fft, options, workspace,
+                                          responses.empty() ? nullptr : responses.data() + i * 2 * (size_t) options.numFrequencies);
+        });
+
+        auto elapsed = (juce::Time::getMillisecondCounterHiRes() - start) * 0.001;
+
+        int counts[4] {};
+        for( auto& r : results )
+            ++counts[static_cast<int> (r.verdict)];
+
+        std::cout << "done in " << elapsed << " s: " << counts[(int) Verdict::Ok] << " ok, "
+                  << counts[(int) Verdict::Deviates] << " deviate (> " << options.toleranceDb << " dB or "
+                  << options.toleranceDegrees << " deg), " << counts[(int) Verdict::Unsettled] << " unsettled, "
+                  << counts[(int) Verdict::Unstable] << " unstable" << std::endl;
+
+        // The ones worth looking at, a screenful at most
+        int listed = 0;
+
+        for( size_t i = 0; i < grid.size() && listed < 20; ++i )
+        {
+            auto& r = results[i];
+
+            if (r.verdict == Verdict::Deviates || r.verdict == Verdict::Unstable)
+            {
+                std::cout << "  " << getVerdictName(r.verdict) << ": " << (grid[i].mode == Mode::Clean ? "clean" : "ladder")
+                          << " @ " << grid[i].sampleRate << " Hz, cutoff " << grid[i].cutoff << ", resonance " << grid[i].resonance
+                          << ", " << r.maxMagnitudeError << " dB / " << r.maxPhaseError << " deg off" << std::endl;
+                ++listed;
+            }
+        }
+
+        if (options.csvFile != juce::File())
+        {
+            options.csvFile.deleteFile();
+            juce::FileOutputStream out (options.csvFile);
+
+            if (! out.openedOk())
+                juce::ConsoleApplication::fail("can't write " + options.csvFile.getFullPathName());
+
+            out << "mode,sample_rate,cutoff,resonance,dc_gain,overshoot_pct,peak_db,peak_hz,max_mag_error_db,max_phase_error_deg,verdict\n";
+
+            for( size_t i = 0; i < grid.size(); ++i )
+            {
+                auto& r = results[i];
+
+                out << (grid[i].mode == Mode::Clean ? "clean" : "ladder") << "," << grid[i].sampleRate << ","
+                    << grid[i].cutoff << "," << grid[i].resonance << "," << r.dcGain << "," << r.overshootPercent << ","
+                    << r.peakDb << "," << r.peakHz << "," << r.maxMagnitudeError << "," << r.maxPhaseError << ","
+                    << getVerdictName(r.verdict) << "\n";
+            }
+        }
+
+        if (! responses.empty())
+            writeResponses(options, grid, responses);
+
+        if (counts[(int) Verdict::Deviates] + counts[(int) Verdict::Unstable] > 0)
+            juce::ConsoleApplication::fail("some grid points failed", 2);
+    }
+}
+
+void addCharacterizeCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "characterize",
+                     "characterize [--cutoffs=N] [--resonances=N] [--rates=44100,48000,...] [--order=O] [--frequencies=N] "
+                     "[--tolerance=dB] [--workers=W] [--csv=file] [--responses=file]",
+                     "Measures the filter engine across the cutoff x resonance x mode x sample rate grid",
+                     "Renders the impulse and step response of every grid point through the engine the plugin runs "
+                     "(the one-pole via CustomFilter's alpha table and the dispatched kernels, and the ladder), in "
+                     "parallel on a worker pool. Checks each for growth or ringing, compares its magnitude and phase "
+                     "with the bilinear-transform design, and prints the points that are unstable or deviate. --csv "
+                     "writes a summary row per point, --responses the measured magnitude/phase curves as float32. "
+                     "Exits with code 2 if any point failed.",
+                     [](const juce::ArgumentList& args) { runCharacterize(args); } });
+}
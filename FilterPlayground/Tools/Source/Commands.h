@@ -0,0 +1,47 @@
+/*
+  ==============================================================================
+
+    Commands.h
+    Created: 9 Oct 2022 4:05:12pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+
+// Each tool registers its subcommand with the console app, see Main.cpp
+
+// loadtest: drives the headless StreamEngine with simulated voice streams
+void addLoadTestCommand(juce::ConsoleApplication& app);
+
+// kernelbench: per-ISA throughput and agreement of the dispatched filter kernels
+void addKernelBenchCommand(juce::ConsoleApplication& app);
+
+// ladder: cost and aliasing of the saturating ladder, antialiased vs oversampled
+void addLadderCommand(juce::ConsoleApplication& app);
+
+// characterize: frequency and time responses over the cutoff/resonance/mode/rate grid
+void addCharacterizeCommand(juce::ConsoleApplication& app);
+
+// spectral: cost per sample and worst block of the STFT filter for each FFT size and overlap
+void addSpectralCommand(juce::ConsoleApplication& app);
+
+// meter: runs a sine through the plugin processor and checks its level meters
+void addMeterCommand(juce::ConsoleApplication& app);
+
+// snapshot: DSP snapshot round trips against an uninterrupted render, per processing mode
+void addSnapshotCommand(juce::ConsoleApplication& app);
+
+// render: offline whole-buffer renders, and the split low-pass's scaling over worker threads
+void addRenderCommand(juce::ConsoleApplication& app);
+
+// quality: adaptive quality tiers against the session's load, back to back and in real time
+void addQualityCommand(juce::ConsoleApplication& app);
+
+// trace: records the plugin's processBlock/worker timeline and writes it as Chrome trace JSON
+void addTraceCommand(juce::ConsoleApplication& app);
+
+// footprint: the plugin's picked filter kernels and the memory one instance holds, per mode
+void addFootprintCommand(juce::ConsoleApplication& app);
@@ -0,0 +1,79 @@
+/*
+  ==============================================================================
+
+    FootprintCommand.cpp
+    Created: 13 Nov 2022 11:42:07am
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "HostedProcessor.h"
+#include <iostream>
+
+namespace
+{
+    void runFootprint(const juce::ArgumentList& args)
+    {
+        auto doubleOption = [&args](const char* name, double defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getDoubleValue();
+        };
+
+        auto sampleRate = doubleOption("--rate", 48000);
+        auto blockSize = static_cast<int> (doubleOption("--block", 512));
+
+        if (sampleRate < 8000 || blockSize < 1)
+            juce::ConsoleApplication::fail("rate must be at least 8000 and block at least 1");
+
+        auto kilobytes = [](size_t bytes) { return juce::String(static_cast<double> (bytes) / 1024.0, 1); };
+
+        std::cout << "footprint: one plugin instance prepared for " << blockSize << "-sample blocks at " << sampleRate
+                  << " Hz" << std::endl;
+
+        {
+            HostedProcessor host;
+            host.prepare(sampleRate, blockSize);
+            std::cout << "filter kernels: " << host.processor.getFilterKernels().name << std::endl << std::endl;
+        }
+
+        std::cout << "mode             instance KB  arena KB  STFT KB  graph KB  total KB" << std::endl;
+
+        // Spectral mode at each FFT size, since the layout it builds is most of what changes
+        for( int fftSize = -1; fftSize <= SpectralFilter::maxOrder - SpectralFilter::minOrder; ++fftSize )
+        {
+            HostedProcessor host;
+
+            if (fftSize >= 0)
+            {
+                host.setParameter("Filter Mode", 2);
+                host.setParameter("FFT Size", static_cast<float> (fftSize));
+            }
+
+            host.prepare(sampleRate, blockSize);
+
+            auto footprint = host.processor.getDspFootprint();
+            auto mode = fftSize < 0 ? juce::String("clean") : "spectral " + juce::String(1 << (SpectralFilter::minOrder + fftSize));
+
+            std::cout << mode.paddedRight(' ', 15)
+                      << kilobytes(footprint.instanceBytes).paddedLeft(' ', 13)
+                      << kilobytes(footprint.arenaBytes).paddedLeft(' ', 10)
+                      << kilobytes(footprint.spectralBytes).paddedLeft(' ', 9)
+                      << kilobytes(footprint.graphBytes).paddedLeft(' ', 10)
+                      << kilobytes(footprint.getTotalBytes()).paddedLeft(' ', 10) << std::endl;
+        }
+    }
+}
+
+void addFootprintCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "footprint",
+                     "footprint [--rate=R] [--block=B]",
+                     "Prints the filter kernels the plugin picked and the memory one instance holds",
+                     "Prepares the plugin processor the way a host would and prints the instruction set its filter "
+                     "kernels were picked for, then getDspFootprint() for the clean mode and for Spectral mode at "
+                     "each FFT size: the processor object, its DSP arena, the STFT layout and the processing graph.",
+                     [](const juce::ArgumentList& args) { runFootprint(args); } });
+}
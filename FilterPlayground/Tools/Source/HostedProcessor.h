@@ -0,0 +1,56 @@
+/*
+  ==============================================================================
+
+    HostedProcessor.h
+    Created: 3 Nov 2022 7:21:40pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include "../../Source/PluginProcessor.h"
+
+// The plugin's processor driven the way a host would, for the tools that test it end to end:
+// parameters set through the apvts, the rate and block size set before prepareToPlay, and whole
+// buffers split into host-sized blocks.
+struct HostedProcessor
+{
+    // Plain value, as the parameter shows it (a choice takes its index)
+    void setParameter(const juce::String& id, float value)
+    {
+        auto* parameter = processor.apvts.getParameter(id);
+
+        if (parameter == nullptr)
+            juce::ConsoleApplication::fail("no parameter called " + id);
+
+        parameter->setValueNotifyingHost(parameter->convertTo0to1(value));
+    }
+
+    void prepare(double sampleRate, int blockSize)
+    {
+        maxBlockSize = blockSize;
+        processor.setRateAndBufferSizeDetails(sampleRate, blockSize);
+        processor.prepareToPlay(sampleRate, blockSize);
+    }
+
+    // In place, in blocks of the prepared size
+    void process(juce::AudioBuffer<float>& buffer)
+    {
+        for( int start = 0; start < buffer.getNumSamples(); start += maxBlockSize )
+        {
+            auto n = juce::jmin(maxBlockSize, buffer.getNumSamples() - start);
+            juce::AudioBuffer<float> block (buffer.getArrayOfWritePointers(), buffer.getNumChannels(), start, n);
+
+            midi.clear();
+            processor.processBlock(block, midi);
+        }
+    }
+
+    // Message manager for the apvts and the latency updates, before the processor that uses them
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+    FilterPlaygroundAudioProcessor processor;
+    juce::MidiBuffer midi;
+    int maxBlockSize {512};
+};
@@ -0,0 +1,145 @@
+/*
+  ==============================================================================
+
+    KernelBenchCommand.cpp
+    Created: 19 Oct 2022 7:30:21pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "../../Source/Engine/FilterKernels.h"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    // Repeats render() over the test signal for about `seconds`, returns samples per second
+    template <typename Render>
+    double measure(Render&& render, int samplesPerCall, double seconds)
+    {
+        render();   // warm up caches and the branch predictor
+
+        juce::int64 calls = 0;
+        auto start = juce::Time::getHighResolutionTicks();
+        auto budget = juce::Time::secondsToHighResolutionTicks(seconds);
+
+        while (juce::Time::getHighResolutionTicks() - start < budget)
+        {
+            for( int i = 0; i < 16; ++i )
+                render();
+
+            calls += 16;
+        }
+
+        auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        return static_cast<double> (calls * samplesPerCall) / elapsed;
+    }
+
+    float maxDifference(const std::vector<float>& a, const std::vector<float>& b)
+    {
+        float difference = 0;
+
+        for( size_t i = 0; i < a.size(); ++i )
+            difference = juce::jmax(difference, std::abs(a[i] - b[i]));
+
+        return difference;
+    }
+
+    void runKernelBench(const juce::ArgumentList& args)
+    {
+        auto blockValue = args.getValueForOption("--block");
+        auto secondsValue = args.getValueForOption("--seconds");
+
+        auto blockSize = blockValue.isEmpty() ? 512 : blockValue.getIntValue();
+        auto seconds = secondsValue.isEmpty() ? 0.5 : secondsValue.getDoubleValue();
+
+        if (blockSize < 4 || seconds <= 0)
+            juce::ConsoleApplication::fail("block must be at least 4 and seconds positive");
+
+        // Noise at roughly full scale through a 1 kHz @ 48 kHz low-pass, ramped up an octave for the ramp kernel
+        const float alpha = 0.0615f, rampedAlpha = 0.115f;
+
+        juce::Random random (0x5eed);
+        std::vector<float> input ((size_t) blockSize);
+
+        for( auto& s : input )
+            s = random.nextFloat() * 2.f - 1.f;
+
+        auto available = FilterKernelDispatch::getAvailableKernels();
+        auto& selected = FilterKernelDispatch::select();
+
+        // Reference output of each kernel from the baseline set, for the deviation column
+        std::vector<float> referenceMono, referenceRamp, referenceStereo;
+
+        std::cout << "kernelbench: " << blockSize << "-sample blocks, " << seconds << " s per kernel, "
+                  << "CPUID/override picks " << selected.name << std::endl
+                  << "isa         mono Msamples/s  ramp Msamples/s  stereo Msamples/s  max deviation" << std::endl;
+
+        double baselineMono = 0;
+
+        for( auto* kernels : available )
+        {
+            std::vector<float> out ((size_t) blockSize), left (input), right (input);
+            float s = 0, sL = 0, sR = 0;
+
+            // Deviation: one pass from zero state, compared against the baseline's pass
+            kernels->process(0.f, alpha, input.data(), out.data(), blockSize);
+            auto mono = out;
+
+            kernels->processRamp(0.f, alpha, rampedAlpha, input.data(), out.data(), blockSize);
+            auto ramp = out;
+
+            kernels->processStereo(sL, sR, alpha, left.data(), right.data(), blockSize);
+            auto stereo = left;
+            stereo.insert(stereo.end(), right.begin(), right.end());
+
+            if (kernels == available.front())
+            {
+                referenceMono = mono;
+                referenceRamp = ramp;
+                referenceStereo = stereo;
+            }
+
+            auto deviation = juce::jmax(maxDifference(mono, referenceMono),
+                                        maxDifference(ramp, referenceRamp),
+                                        maxDifference(stereo, referenceStereo));
+
+            // Throughput: states carry over between calls like they do across audio blocks
+            auto monoRate = measure([&] { s = kernels->process(s, alpha, input.data(), out.data(), blockSize); }, blockSize, seconds);
+            auto rampRate = measure([&] { s = kernels->processRamp(s, alpha, rampedAlpha, input.data(), out.data(), blockSize); }, blockSize, seconds);
+            auto stereoRate = measure([&]
+            {
+                std::copy(input.begin(), input.end(), left.begin());
+                std::copy(input.begin(), input.end(), right.begin());
+                kernels->processStereo(sL, sR, alpha, left.data(), right.data(), blockSize);
+            }, 2 * blockSize, seconds);
+
+            if (kernels == available.front())
+                baselineMono = monoRate;
+
+            std::cout << juce::String(kernels->name).paddedRight(' ', 10)
+                      << juce::String(monoRate * 1.0e-6, 1).paddedLeft(' ', 8)
+                      << " (" << juce::String(monoRate / baselineMono, 2) << "x)"
+                      << juce::String(rampRate * 1.0e-6, 1).paddedLeft(' ', 17)
+                      << juce::String(stereoRate * 1.0e-6, 1).paddedLeft(' ', 19)
+                      << "  " << deviation << std::endl;
+        }
+
+        if (available.size() < FilterKernelDispatch::getCompiledKernels().size())
+            std::cout << "(sets this CPU can't run are skipped)" << std::endl;
+    }
+}
+
+void addKernelBenchCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "kernelbench",
+                     "kernelbench [--block=B] [--seconds=S]",
+                     "Times the one-pole kernels for every instruction set this CPU supports",
+                     "Runs the mono, ramped and stereo one-pole kernels compiled for each ISA (SSE2/NEON baseline, "
+                     "AVX2, AVX-512) over a block of noise and prints throughput, the speed-up over the baseline "
+                     "and the largest output difference from the baseline. Set FILTERPLAYGROUND_KERNELS to "
+                     "override which set the plugin and the stream engine use.",
+                     [](const juce::ArgumentList& args) { runKernelBench(args); } });
+}
@@ -0,0 +1,296 @@
+/*
+  ==============================================================================
+
+    LadderCommand.cpp
+    Created: 21 Oct 2022 6:02:37pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "../../Source/Engine/LadderFilter.h"
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    // The usual alternative to antiderivative antialiasing, for comparison: run the plain ladder
+    // at four times the rate between polyphase windowed-sinc interpolation and decimation.
+    class Oversampled4x
+    {
+    public:
+        static constexpr int factor = 4;
+        static constexpr int tapsPerPhase = 32;
+        static constexpr int numTaps = factor * tapsPerPhase;
+
+        Oversampled4x(double sampleRate, int maxBlock)
+            : kernel ((size_t) numTaps),
+              inputs ((size_t) (tapsPerPhase - 1 + maxBlock)),
+              upsampled ((size_t) (numTaps - 1 + factor * maxBlock))
+        {
+            // Blackman-windowed sinc, passband to about 20 kHz at 48 kHz
+            const double cutoff = 0.42 / factor;
+            double sum = 0;
+
+            for( int t = 0; t < numTaps; ++t )
+            {
+                auto x = t - (numTaps - 1) * 0.5;
+                auto sinc = x == 0 ? 2.0 * cutoff : std::sin(2.0 * juce::MathConstants<double>::pi * cutoff * x) / (juce::MathConstants<double>::pi * x);
+                auto phase = 2.0 * juce::MathConstants<double>::pi * t / (numTaps - 1);
+                kernel[(size_t) t] = static_cast<float> (sinc * (0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2.0 * phase)));
+                sum += kernel[(size_t) t];
+            }
+
+            for( auto& h : kernel )
+                h = static_cast<float> (h / sum);
+
+            filter.prepare(factor * sampleRate);
+            filter.setAntialiasing(LadderAntialiasing::None);
+        }
+
+        LadderFilter& getFilter() noexcept { return filter; }
+
+        void process(const float* in, float* out, int numSamples) noexcept
+        {
+            auto* history = inputs.data() + tapsPerPhase - 1;
+            auto* up = upsampled.data() + numTaps - 1;
+
+            std::copy(in, in + numSamples, history);
+
+            // Zero-stuffing then filtering, done a phase at a time so the zeros are never multiplied
+            for( int i = 0; i < numSamples; ++i )
+                for( int p = 0; p < factor; ++p )
+                {
+                    float sum = 0;
+
+                    for( int j = 0; j < tapsPerPhase; ++j )
+                        sum += kernel[(size_t) (p + factor * j)] * history[i - j];
+
+                    up[factor * i + p] = factor * sum;
+                }
+
+            filter.process(up, up, factor * numSamples);
+
+            for( int i = 0; i < numSamples; ++i )
+            {
+                float sum = 0;
+                auto* last = up + factor * i + factor - 1;
+
+                for( int t = 0; t < numTaps; ++t )
+                    sum += kernel[(size_t) t] * last[-t];
+
+                out[i] = sum;
+            }
+
+            std::copy(history + numSamples - (tapsPerPhase - 1), history + numSamples, inputs.data());
+            std::copy(up + factor * numSamples - (numTaps - 1), up + factor * numSamples, upsampled.data());
+        }
+
+    private:
+        std::vector<float> kernel, inputs, upsampled;
+        LadderFilter filter;
+    };
+
+    struct LadderOptions
+    {
+        double sampleRate {48000};
+        float cutoff {4000};
+        float resonance {0.7f};
+        float level {4};
+        double tone {3000};
+        double seconds {0.5};
+    };
+
+    template <typename Render>
+    double nanosecondsPerSample(Render&& render, int samplesPerCall, double seconds)
+    {
+        render();
+
+        juce::int64 calls = 0;
+        auto start = juce::Time::getHighResolutionTicks();
+        auto budget = juce::Time::secondsToHighResolutionTicks(seconds);
+
+        while (juce::Time::getHighResolutionTicks() - start < budget)
+        {
+            render();
+            ++calls;
+        }
+
+        auto elapsed = juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start);
+        return elapsed * 1.0e9 / static_cast<double> (calls * samplesPerCall);
+    }
+
+    // Aliased energy relative to the harmonics, in dB. The tone sits exactly on odd bin k of an
+    // N-point FFT, so the output is periodic in N (no window needed) and every true harmonic
+    // lands on a multiple of k. Harmonics above Nyquist fold to bins that aren't (for the first
+    // k folds, N being a power of two), so whatever isn't on a multiple of k is aliasing.
+    template <typename Render>
+    double measureAliasing(Render&& render, const LadderOptions& options)
+    {
+        constexpr int order = 12, size = 1 << order, blockSize = 512;
+
+        auto bin = juce::jmax(1, static_cast<int> (options.tone * size / options.sampleRate)) | 1;
+
+        std::vector<float> input ((size_t) size), output (2 * (size_t) size);
+
+        for( int i = 0; i < size; ++i )
+            input[(size_t) i] = options.level * static_cast<float> (std::sin(2.0 * juce::MathConstants<double>::pi * bin * i / size));
+
+        // Settle into the periodic steady state, then keep the last period
+        for( int period = 0; period < 16; ++period )
+            for( int i = 0; i < size; i += blockSize )
+                render(input.data() + i, output.data() + i, blockSize);
+
+        juce::dsp::FFT fft (order);
+        fft.performFrequencyOnlyForwardTransform(output.data());
+
+        double harmonics = 0, aliases = 0;
+
+        for( int b = 1; b < size / 2; ++b )
+        {
+            auto power = static_cast<double> (output[(size_t) b]) * output[(size_t) b];
+            (b % bin == 0 ? harmonics : aliases) += power;
+        }
+
+        return 10.0 * std::log10(juce::jmax(aliases, 1.0e-30) / juce::jmax(harmonics, 1.0e-30));
+    }
+
+    // The tone through the ladder in blocks, with the antialiasing for each block picked by mode()
+    template <typename Mode>
+    std::vector<float> renderTone(const LadderOptions& options, int blockSize, Mode&& mode)
+    {
+        auto numSamples = static_cast<int> (options.sampleRate * 0.5) / blockSize * blockSize;
+        std::vector<float> signal ((size_t) numSamples);
+
+        for( int i = 0; i < numSamples; ++i )
+            signal[(size_t) i] = options.level * static_cast<float> (std::sin(2.0 * juce::MathConstants<double>::pi * options.tone * i / options.sampleRate));
+
+        LadderFilter ladder;
+        ladder.prepare(options.sampleRate);
+        ladder.setParameters(options.cutoff, options.resonance);
+
+        for( int block = 0; block * blockSize < numSamples; ++block )
+        {
+            ladder.setAntialiasing(mode(block));
+            ladder.process(signal.data() + block * blockSize, signal.data() + block * blockSize, blockSize);
+        }
+
+        return signal;
+    }
+
+    // Worst difference between two renders relative to the peak of the first, in dB
+    double worstDifference(const std::vector<float>& reference, const std::vector<float>& other)
+    {
+        double peak = 0, worst = 0;
+
+        for( size_t i = 0; i < reference.size(); ++i )
+        {
+            peak = juce::jmax(peak, std::abs(static_cast<double> (reference[i])));
+            worst = juce::jmax(worst, std::abs(static_cast<double> (other[i]) - reference[i]));
+        }
+
+        return 20.0 * std::log10(juce::jmax(worst, 1.0e-30) / juce::jmax(peak, 1.0e-30));
+    }
+
+    void runLadder(const juce::ArgumentList& args)
+    {
+        LadderOptions options;
+
+        auto doubleOption = [&args](const char* name, double defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getDoubleValue();
+        };
+
+        options.sampleRate = doubleOption("--rate", options.sampleRate);
+        options.cutoff = static_cast<float> (doubleOption("--cutoff", options.cutoff));
+        options.resonance = static_cast<float> (doubleOption("--resonance", options.resonance));
+        options.level = static_cast<float> (doubleOption("--level", options.level));
+        options.tone = doubleOption("--tone", options.tone);
+        options.seconds = doubleOption("--seconds", options.seconds);
+
+        if (options.sampleRate < 8000 || options.tone <= 0 || options.tone >= options.sampleRate / 2 || options.seconds <= 0)
+            juce::ConsoleApplication::fail("rate must be at least 8000, tone below Nyquist and seconds positive");
+
+        constexpr int blockSize = 512;
+
+        juce::Random random (0x5eed);
+        std::vector<float> noise ((size_t) blockSize), out ((size_t) blockSize);
+
+        for( auto& s : noise )
+            s = options.level * (random.nextFloat() * 2.f - 1.f);
+
+        std::cout << "ladder: " << options.cutoff << " Hz cutoff, resonance " << options.resonance << ", "
+                  << options.tone << " Hz tone at " << options.level << ", " << options.sampleRate << " Hz" << std::endl
+                  << "mode              ns/sample  aliasing dB" << std::endl;
+
+        double plainCost = 0;
+
+        auto report = [&](const char* name, double cost, double aliasing)
+        {
+            if (plainCost == 0)
+                plainCost = cost;
+
+            std::cout << juce::String(name).paddedRight(' ', 16)
+                      << juce::String(cost, 1).paddedLeft(' ', 11)
+                      << juce::String(aliasing, 1).paddedLeft(' ', 13)
+                      << "   (" << juce::String(cost / plainCost, 1) << "x the plain cost)" << std::endl;
+        };
+
+        const std::pair<LadderAntialiasing, const char*> modes[] { { LadderAntialiasing::None, "plain" },
+                                                                   { LadderAntialiasing::FirstOrder, "ADAA" } };
+
+        for( auto& mode : modes )
+        {
+            LadderFilter ladder;
+            ladder.prepare(options.sampleRate);
+            ladder.setAntialiasing(mode.first);
+            ladder.setParameters(options.cutoff, options.resonance);
+
+            auto cost = nanosecondsPerSample([&] { ladder.process(noise.data(), out.data(), blockSize); }, blockSize, options.seconds);
+
+            ladder.reset();
+            auto aliasing = measureAliasing([&](const float* in, float* o, int n) { ladder.process(in, o, n); }, options);
+
+            report(mode.second, cost, aliasing);
+        }
+
+        Oversampled4x oversampled (options.sampleRate, blockSize);
+        oversampled.getFilter().setParameters(options.cutoff, options.resonance);
+
+        auto cost = nanosecondsPerSample([&] { oversampled.process(noise.data(), out.data(), blockSize); }, blockSize, options.seconds);
+        oversampled.getFilter().reset();
+
+        report("plain, 4x", cost, measureAliasing([&](const float* in, float* o, int n) { oversampled.process(in, o, n); }, options));
+
+        // The adaptive quality tier switches between the two mid-note. Switching every block
+        // shouldn't stray from the antialiased render any further than the plain one does;
+        // a step at the switches would.
+        auto antialiased = renderTone(options, blockSize, [](int) { return LadderAntialiasing::FirstOrder; });
+        auto plain = renderTone(options, blockSize, [](int) { return LadderAntialiasing::None; });
+        auto switching = renderTone(options, blockSize, [](int block) { return block % 2 == 1 ? LadderAntialiasing::None
+                                                                                                : LadderAntialiasing::FirstOrder; });
+
+        std::cout << std::endl << "against ADAA throughout, worst difference relative to its peak:" << std::endl
+                  << juce::String("plain throughout").paddedRight(' ', 32)
+                  << juce::String(worstDifference(antialiased, plain), 1).paddedLeft(' ', 7) << " dB" << std::endl
+                  << ("switching every " + juce::String(blockSize) + " samples").paddedRight(' ', 32)
+                  << juce::String(worstDifference(antialiased, switching), 1).paddedLeft(' ', 7) << " dB" << std::endl;
+    }
+}
+
+void addLadderCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "ladder",
+                     "ladder [--cutoff=Hz] [--resonance=0..1] [--level=L] [--tone=Hz] [--rate=R] [--seconds=S]",
+                     "Times the saturating ladder and measures its aliasing against 4x oversampling",
+                     "Runs the ladder plain, with first-order antiderivative antialiasing, and plain at "
+                     "four times the rate behind a windowed-sinc resampler. Prints the cost per sample over a block "
+                     "of noise and, for a sine at the given level, the energy that folded back below Nyquist "
+                     "relative to the harmonics. Then renders the tone switching between plain and antialiased "
+                     "every block, as the adaptive quality tier does, and prints how far that and the plain "
+                     "render stray from the antialiased one; a step at the switches shows up as the former "
+                     "straying further.",
+                     [](const juce::ArgumentList& args) { runLadder(args); } });
+}
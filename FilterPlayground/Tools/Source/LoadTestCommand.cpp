@@ -0,0 +1,227 @@
+/*
+  ==============================================================================
+
+    LoadTestCommand.cpp
+    Created: 9 Oct 2022 4:11:48pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "../../Source/Engine/StreamEngine.h"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    struct LoadTestOptions
+    {
+        int numStreams {512};
+        double seconds {10};
+        int blockSize {480};        // 10 ms at 48 kHz, a typical voice frame
+        bool flatOut {false};       // submit as fast as blocks come back instead of in real time
+        juce::File csvFile;
+        StreamEngine::Options engine;
+    };
+
+    LoadTestOptions parseOptions(const juce::ArgumentList& args)
+    {
+        LoadTestOptions options;
+
+        auto intOption = [&args](const char* name, int defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getIntValue();
+        };
+
+        options.numStreams = intOption("--streams", options.numStreams);
+        options.blockSize = intOption("--block", options.blockSize);
+        options.flatOut = args.containsOption("--flat-out");
+
+        auto seconds = args.getValueForOption("--seconds");
+        if (seconds.isNotEmpty())
+            options.seconds = seconds.getDoubleValue();
+
+        auto csv = args.getValueForOption("--csv");
+        if (csv.isNotEmpty())
+            options.csvFile = juce::File::getCurrentWorkingDirectory().getChildFile(csv);
+
+        options.engine.sampleRate = intOption("--rate", 48000);
+        options.engine.numChannels = intOption("--channels", 1);
+        options.engine.numWorkers = intOption("--workers", options.engine.numWorkers);
+        options.engine.pinWorkers = ! args.containsOption("--no-pin");
+        options.engine.maxStreams = options.numStreams;
+
+        if (options.numStreams < 1 || options.blockSize < 1 || options.engine.numChannels < 1 || options.seconds <= 0)
+            juce::ConsoleApplication::fail("streams, block, channels and seconds must be positive");
+
+        if (options.numStreams > juce::jmax(1, options.engine.numWorkers) * WorkerPool::queueCapacity)
+            juce::ConsoleApplication::fail("too many streams for " + juce::String(options.engine.numWorkers) + " workers");
+
+        return options;
+    }
+
+    // One simulated voice channel: its audio, the block handed to the engine and when the next one is due
+    struct SimulatedStream
+    {
+        int id {-1};
+        std::vector<float> samples;
+        std::vector<float*> channels;
+        StreamBlock block;
+        double nextDue {0};
+        juce::int64 missedDeadlines {0};
+    };
+
+    void fillWithNoise(SimulatedStream& stream, juce::Random& random)
+    {
+        for( auto& s : stream.samples )
+            s = random.nextFloat() * 0.5f - 0.25f;
+    }
+
+    void runLoadTest(const juce::ArgumentList& args)
+    {
+        auto options = parseOptions(args);
+        StreamEngine engine (options.engine);
+
+        std::vector<SimulatedStream> streams ((size_t) options.numStreams);
+        juce::Random random (0x5eed);
+
+        auto blockSeconds = options.blockSize / options.engine.sampleRate;
+        auto start = juce::Time::getMillisecondCounterHiRes() * 0.001;
+
+        for( auto& stream : streams )
+        {
+            stream.id = engine.addStream(200.f + random.nextFloat() * 7800.f);
+            stream.samples.resize((size_t) (options.blockSize * options.engine.numChannels));
+
+            for( int ch = 0; ch < options.engine.numChannels; ++ch )
+                stream.channels.push_back(stream.samples.data() + ch * options.blockSize);
+
+            stream.block.channels = stream.channels.data();
+            stream.block.numSamples = options.blockSize;
+
+            // Real voice channels don't all tick at once, spread the first deadlines over a block
+            stream.nextDue = start + random.nextDouble() * blockSeconds;
+        }
+
+        std::cout << "loadtest: " << options.numStreams << " streams x " << options.engine.numChannels << " ch, "
+                  << options.blockSize << " samples @ " << options.engine.sampleRate << " Hz, "
+                  << engine.getNumWorkers() << (options.engine.pinWorkers ? " pinned" : "") << " workers, "
+                  << engine.getKernels().name << " kernels, "
+                  << (options.flatOut ? "flat out" : "real time") << ", " << options.seconds << " s" << std::endl;
+
+        auto end = start + options.seconds;
+        auto now = start;
+
+        while (now < end)
+        {
+            auto nextWake = end;
+
+            for( auto& stream : streams )
+            {
+                if (options.flatOut)
+                {
+                    if (stream.block.isDone())
+                    {
+                        fillWithNoise(stream, random);
+                        engine.submit(stream.id, stream.block);
+                    }
+
+                    continue;
+                }
+
+                if (stream.nextDue <= now)
+                {
+                    // The previous block should have come back within one block period
+                    if (stream.block.isDone())
+                    {
+                        fillWithNoise(stream, random);
+                        engine.submit(stream.id, stream.block);
+                    }
+                    else
+                    {
+                        ++stream.missedDeadlines;
+                    }
+
+                    stream.nextDue += blockSeconds;
+                }
+
+                nextWake = juce::jmin(nextWake, stream.nextDue);
+            }
+
+            now = juce::Time::getMillisecondCounterHiRes() * 0.001;
+
+            if (! options.flatOut && nextWake - now > 0.001)
+                juce::Thread::sleep(juce::jmax(1, static_cast<int> ((nextWake - now) * 1000.0) - 1));
+
+            now = juce::Time::getMillisecondCounterHiRes() * 0.001;
+        }
+
+        // Let the last blocks land so every stream's numbers are complete
+        for( auto& stream : streams )
+            while (! stream.block.isDone())
+                juce::Thread::yield();
+
+        auto elapsed = juce::Time::getMillisecondCounterHiRes() * 0.001 - start;
+
+        std::vector<StreamStats> stats;
+        juce::int64 totalSamples = 0, totalMissed = 0, totalRejected = 0;
+        double worstLatency = 0;
+
+        for( auto& stream : streams )
+        {
+            stats.push_back(engine.getStats(stream.id));
+            totalSamples += stats.back().samples;
+            totalRejected += stats.back().rejectedBlocks;
+            totalMissed += stream.missedDeadlines;
+            worstLatency = juce::jmax(worstLatency, stats.back().maxLatencyMs);
+        }
+
+        std::vector<double> meanLatencies;
+        for( auto& s : stats )
+            meanLatencies.push_back(s.meanLatencyMs);
+
+        std::sort(meanLatencies.begin(), meanLatencies.end());
+
+        auto percentile = [&meanLatencies](double p)
+        {
+            return meanLatencies[(size_t) juce::jlimit(0, (int) meanLatencies.size() - 1, static_cast<int> (p * (double) meanLatencies.size()))];
+        };
+
+        auto audioSeconds = static_cast<double> (totalSamples) / options.engine.sampleRate;
+
+        std::cout << "throughput: " << static_cast<juce::int64> (static_cast<double> (totalSamples) / elapsed) << " samples/s per channel, "
+                  << audioSeconds / elapsed << "x real time, i.e. that many streams kept up" << std::endl
+                  << "latency (per-stream mean): median " << percentile(0.5) << " ms, p99 " << percentile(0.99)
+                  << " ms; worst block " << worstLatency << " ms" << std::endl
+                  << "missed deadlines: " << totalMissed << ", rejected blocks: " << totalRejected << std::endl;
+
+        if (options.csvFile != juce::File())
+        {
+            options.csvFile.deleteFile();
+            juce::FileOutputStream out (options.csvFile);
+
+            if (! out.openedOk())
+                juce::ConsoleApplication::fail("can't write " + options.csvFile.getFullPathName());
+
+            out << "stream,blocks,samples,rejected,missed,mean_latency_ms,max_latency_ms,realtime_factor\n";
+
+            for( size_t i = 0; i < streams.size(); ++i )
+                out << streams[i].id << "," << stats[i].blocks << "," << stats[i].samples << "," << stats[i].rejectedBlocks << ","
+                    << streams[i].missedDeadlines << "," << stats[i].meanLatencyMs << "," << stats[i].maxLatencyMs << ","
+                    << stats[i].realtimeFactor << "\n";
+        }
+    }
+}
+
+void addLoadTestCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "loadtest",
+                     "loadtest [--streams=N] [--seconds=S] [--block=B] [--rate=R] [--channels=C] [--workers=W] [--no-pin] [--flat-out] [--csv=file]",
+                     "Runs simulated voice streams through the headless stream engine",
+                     "Each stream submits a block of noise every block period (or as soon as the last one returns with "
+                     "--flat-out) and must get it back before the next is due. Prints throughput, per-stream latency "
+                     "percentiles and deadline misses; --csv writes every stream's published stats.",
+                     [](const juce::ArgumentList& args) { runLoadTest(args); } });
+}
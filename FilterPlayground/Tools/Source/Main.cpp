@@ -0,0 +1,32 @@
+/*
+  ==============================================================================
+
+    This file contains the basic startup code for a JUCE application.
+
+  ==============================================================================
+*/
+
+#include <JuceHeader.h>
+#include "Commands.h"
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ConsoleApplication app;
+
+    app.addHelpCommand("--help|-h", "Usage: FilterPlaygroundTools <command> [options]", true);
+
+    addLoadTestCommand(app);
+    addKernelBenchCommand(app);
+    addLadderCommand(app);
+    addCharacterizeCommand(app);
+    addSpectralCommand(app);
+    addMeterCommand(app);
+    addSnapshotCommand(app);
+    addRenderCommand(app);
+    addQualityCommand(app);
+    addTraceCommand(app);
+    addFootprintCommand(app);
+
+    return app.findAndRunCommand(argc, argv);
+}
@@ -0,0 +1,143 @@
+/*
+  ==============================================================================
+
+    MeterCommand.cpp
+    Created: 3 Nov 2022 7:48:02pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "HostedProcessor.h"
+#include <iostream>
+
+namespace
+{
+    float toDb(float gain) { return juce::Decibels::gainToDecibels(gain, -100.f); }
+
+    void fillSine(juce::AudioBuffer<float>& buffer, double frequency, float amplitude, double sampleRate, juce::int64& phase)
+    {
+        for( int i = 0; i < buffer.getNumSamples(); ++i, ++phase )
+        {
+            auto sample = amplitude * static_cast<float> (std::sin(juce::MathConstants<double>::twoPi * frequency * static_cast<double> (phase) / sampleRate));
+
+            for( int ch = 0; ch < buffer.getNumChannels(); ++ch )
+                buffer.setSample(ch, i, sample);
+        }
+    }
+
+    void runMeter(const juce::ArgumentList& args)
+    {
+        auto doubleOption = [&args](const char* name, double defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getDoubleValue();
+        };
+
+        auto sampleRate = doubleOption("--rate", 48000);
+        auto blockSize = static_cast<int> (doubleOption("--block", 512));
+
+        if (sampleRate < 8000 || blockSize < 1)
+            juce::ConsoleApplication::fail("rate must be at least 8000 and block at least 1");
+
+        // A 1 kHz sine at -6 dBFS on both channels through the clean low-pass at 1 kHz, where it's
+        // down 3 dB. The input loudness of a stereo 1 kHz sine equals its level in dBFS (BS.1770).
+        const double frequency = 1000;
+        const float amplitude = juce::Decibels::decibelsToGain(-6.f);
+
+        HostedProcessor host;
+        host.setParameter("Filter Mode", 0);
+        host.setParameter("LowPass Freq", static_cast<float> (frequency));
+        host.prepare(sampleRate, blockSize);
+
+        // Read the way the editor's 30 Hz timer does
+        auto readInterval = static_cast<int> (sampleRate / 30);
+        juce::AudioBuffer<float> buffer (2, readInterval);
+        juce::int64 phase = 0;
+        LevelReadings in, out;
+
+        std::cout << "meter: 1 kHz sine at -6 dBFS through the 1 kHz clean low-pass, " << blockSize << "-sample blocks at "
+                  << sampleRate << " Hz, read at 30 Hz" << std::endl
+                  << "   s   in peak  in rms  in true  in LUFS   out peak  out rms  out LUFS" << std::endl;
+
+        auto reads = static_cast<int> (3.5 * 30);
+
+        for( int r = 1; r <= reads; ++r )
+        {
+            fillSine(buffer, frequency, amplitude, sampleRate, phase);
+            host.process(buffer);
+
+            in = host.processor.getInputLevels();
+            out = host.processor.getOutputLevels();
+
+            if (r % 15 == 0 || r == reads)
+                std::cout << juce::String(r / 30.0, 1).paddedLeft(' ', 4)
+                          << juce::String(toDb(in.peak[0]), 2).paddedLeft(' ', 10)
+                          << juce::String(toDb(in.rms[0]), 2).paddedLeft(' ', 8)
+                          << juce::String(toDb(in.truePeak), 2).paddedLeft(' ', 9)
+                          << juce::String(in.shortTermLufs, 2).paddedLeft(' ', 9)
+                          << juce::String(toDb(out.peak[0]), 2).paddedLeft(' ', 11)
+                          << juce::String(toDb(out.rms[0]), 2).paddedLeft(' ', 9)
+                          << juce::String(out.shortTermLufs, 2).paddedLeft(' ', 10) << std::endl;
+        }
+
+        int failures = 0;
+
+        auto check = [&failures](bool ok, const juce::String& description)
+        {
+            failures += ok ? 0 : 1;
+            std::cout << (ok ? "ok    " : "FAIL  ") << description << std::endl;
+        };
+
+        auto expect = [&check](const juce::String& what, float measured, float expected, float tolerance)
+        {
+            check(std::abs(measured - expected) <= tolerance,
+                  what + " " + juce::String(measured, 2) + " (expected " + juce::String(expected, 2) + " +/- " + juce::String(tolerance, 2) + ")");
+        };
+
+        auto level = toDb(amplitude);
+
+        expect("input true peak dB", toDb(in.truePeak), level, 0.2f);
+        expect("input loudness LUFS", in.shortTermLufs, level, 0.3f);
+
+        for( int ch = 0; ch < 2; ++ch )
+        {
+            expect("input rms dB, channel " + juce::String(ch), toDb(in.rms[(size_t) ch]), level - 3.01f, 0.1f);
+            expect("output rms dB, channel " + juce::String(ch), toDb(out.rms[(size_t) ch]), level - 6.02f, 0.1f);
+        }
+
+        // Nobody reading for longer than the idle timeout: the meters stop, so a full-scale burst
+        // afterwards doesn't show up, and picks up again once something reads them
+        juce::AudioBuffer<float> silence (2, static_cast<int> (2.5 * sampleRate));
+        silence.clear();
+        host.process(silence);
+
+        juce::AudioBuffer<float> burst (2, static_cast<int> (0.2 * sampleRate));
+        fillSine(burst, frequency, 1.f, sampleRate, phase);
+        host.process(burst);
+
+        auto idlePeak = toDb(host.processor.getInputLevels().peak[0]);
+        check(idlePeak < -20.f, "unread input meter stopped before the burst, peak " + juce::String(idlePeak, 2) + " dB");
+
+        fillSine(burst, frequency, 1.f, sampleRate, phase);
+        host.process(burst);
+        expect("input true peak dB once read again", toDb(host.processor.getInputLevels().truePeak), 0.f, 0.2f);
+
+        if (failures > 0)
+            juce::ConsoleApplication::fail(juce::String(failures) + " meter check(s) failed");
+    }
+}
+
+void addMeterCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "meter",
+                     "meter [--rate=R] [--block=B]",
+                     "Runs a sine through the processor and checks its level meters",
+                     "Drives the plugin processor with a 1 kHz sine at -6 dBFS through the clean low-pass at 1 kHz, "
+                     "reading getInputLevels() and getOutputLevels() at 30 Hz the way the editor does, and prints "
+                     "the readings. Checks input true peak, RMS and short-term loudness against the signal, output "
+                     "RMS against the filter's -3 dB at cutoff, and that the meters stop while nobody reads them "
+                     "and pick up again once something does. Exits non-zero if any check fails.",
+                     [](const juce::ArgumentList& args) { runMeter(args); } });
+}
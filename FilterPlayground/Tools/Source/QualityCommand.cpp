@@ -0,0 +1,188 @@
+/*
+  ==============================================================================
+
+    QualityCommand.cpp
+    Created: 7 Nov 2022 5:48:19pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "HostedProcessor.h"
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    struct SessionResult
+    {
+        double busy {0};            // share of the thread's time spent in processBlock
+        double ownLoad {0};         // mean over the instances
+        double sessionLoad {0};     // as the instances saw it, the highest
+        int tiers[3] {};
+    };
+
+    // Cheap instances, all in Adaptive quality with the cutoff on the LFO, run the way a host on one
+    // audio thread would: every instance's block in turn, then a wait until the block's real-time
+    // duration is up
+    SessionResult runSession(int numInstances, int numCycles, double sampleRate, int blockSize)
+    {
+        std::vector<std::unique_ptr<HostedProcessor>> session;
+
+        for( int i = 0; i < numInstances; ++i )
+        {
+            session.push_back(std::make_unique<HostedProcessor>());
+
+            auto& host = *session.back();
+            host.setParameter("Quality", 0);
+            host.setParameter("LowPass Freq", 800.f + 10.f * static_cast<float> (i % 100));
+            host.setParameter("Mod 1 Source", 1);
+            host.setParameter("Mod 1 Target", 0);
+            host.setParameter("Mod 1 Depth", 0.5f);
+            host.prepare(sampleRate, blockSize);
+        }
+
+        // Noise made up front, so the thread's time goes on the instances and not on the tool
+        juce::AudioBuffer<float> noise (2, blockSize), block (2, blockSize);
+        juce::Random random (0x5eed);
+
+        for( int ch = 0; ch < 2; ++ch )
+            for( int i = 0; i < blockSize; ++i )
+                noise.setSample(ch, i, (random.nextFloat() * 2.f - 1.f) * 0.25f);
+
+        auto blockSeconds = blockSize / sampleRate;
+        auto start = juce::Time::getMillisecondCounterHiRes() * 0.001;
+        auto next = start;
+        juce::int64 busyTicks = 0;
+
+        for( int cycle = 0; cycle < numCycles; ++cycle )
+        {
+            for( auto& host : session )
+            {
+                block.makeCopyOf(noise);
+
+                auto ticks = juce::Time::getHighResolutionTicks();
+                host->process(block);
+                busyTicks += juce::Time::getHighResolutionTicks() - ticks;
+            }
+
+            next += blockSeconds;
+            auto wait = next - juce::Time::getMillisecondCounterHiRes() * 0.001;
+
+            if (wait > 0)
+                juce::Thread::sleep(static_cast<int> (wait * 1000.0));
+        }
+
+        SessionResult result;
+        result.busy = juce::Time::highResolutionTicksToSeconds(busyTicks) / (juce::Time::getMillisecondCounterHiRes() * 0.001 - start);
+
+        for( auto& host : session )
+        {
+            result.ownLoad += host->processor.getProcessingLoad() / numInstances;
+            result.sessionLoad = juce::jmax(result.sessionLoad, static_cast<double> (host->processor.getSessionLoad()));
+            ++result.tiers[static_cast<int> (host->processor.getQualityTier())];
+        }
+
+        return result;
+    }
+
+    // One instance's processBlock time, for sizing the sessions
+    double secondsPerBlock(double sampleRate, int blockSize)
+    {
+        HostedProcessor host;
+        host.setParameter("Mod 1 Source", 1);
+        host.setParameter("Mod 1 Target", 0);
+        host.setParameter("Mod 1 Depth", 0.5f);
+        host.prepare(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> block (2, blockSize);
+        constexpr int numBlocks = 2000;
+        auto best = 1.0e30;
+
+        for( int run = 0; run < 3; ++run )
+        {
+            auto start = juce::Time::getHighResolutionTicks();
+
+            for( int i = 0; i < numBlocks; ++i )
+                host.process(block);
+
+            best = juce::jmin(best, juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start) / numBlocks);
+        }
+
+        return best;
+    }
+
+    void runQuality(const juce::ArgumentList& args)
+    {
+        auto doubleOption = [&args](const char* name, double defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getDoubleValue();
+        };
+
+        auto sampleRate = doubleOption("--rate", 48000);
+        auto blockSize = static_cast<int> (doubleOption("--block", 512));
+        auto numCycles = static_cast<int> (doubleOption("--blocks", 100));
+
+        if (sampleRate < 8000 || blockSize < 1 || numCycles < 1)
+            juce::ConsoleApplication::fail("rate must be at least 8000, block and blocks at least 1");
+
+        QualityPolicy policy;
+        auto budget = blockSize / sampleRate;
+        auto perBlock = secondsPerBlock(sampleRate, blockSize);
+
+        // Enough instances to keep the thread about 80% busy, where a host is close to dropping out,
+        // and few enough for 10%
+        auto instancesFor = [&](double busy) { return juce::jlimit(1, 4000, static_cast<int> (std::ceil(busy * budget / perBlock))); };
+
+        std::cout << "quality: adaptive instances with the LFO on the cutoff, " << blockSize << "-sample blocks at " << sampleRate
+                  << " Hz, " << numCycles << " blocks paced in real time; one block takes "
+                  << juce::String(perBlock * 1.0e6, 1) << " us, " << juce::String(perBlock / budget * 100.0, 2) << "% of its duration" << std::endl
+                  << "policy: steps down with the session above " << juce::String(policy.stepDownLoad * 100.0, 0) << "% for "
+                  << policy.blocksBeforeStepDown << " blocks" << std::endl << std::endl
+                  << "instances  thread busy  own load  session load  Full  Reduced  Minimum" << std::endl;
+
+        int failures = 0;
+
+        auto check = [&](int numInstances, QualityTier expected)
+        {
+            auto result = runSession(numInstances, numCycles, sampleRate, blockSize);
+            auto ok = result.tiers[static_cast<int> (expected)] == numInstances;
+            failures += ok ? 0 : 1;
+
+            auto percent = [](double load) { return juce::String(load * 100.0, 1) + "%"; };
+
+            std::cout << juce::String(numInstances).paddedLeft(' ', 9)
+                      << percent(result.busy).paddedLeft(' ', 13)
+                      << (juce::String(result.ownLoad * 100.0, 2) + "%").paddedLeft(' ', 10)
+                      << percent(result.sessionLoad).paddedLeft(' ', 14)
+                      << juce::String(result.tiers[0]).paddedLeft(' ', 6)
+                      << juce::String(result.tiers[1]).paddedLeft(' ', 9)
+                      << juce::String(result.tiers[2]).paddedLeft(' ', 9)
+                      << (ok ? "" : "  FAIL") << std::endl;
+        };
+
+        // Each instance's own load is tiny either way, only the session's tells them apart
+        check(instancesFor(0.8), QualityTier::Minimum);
+        check(instancesFor(0.1), QualityTier::Full);
+
+        if (failures > 0)
+            juce::ConsoleApplication::fail("the adaptive tier didn't follow the session's load");
+    }
+}
+
+void addQualityCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "quality",
+                     "quality [--blocks=B] [--block=S] [--rate=R]",
+                     "Checks that adaptive quality follows the whole session's load",
+                     "Times one cheap plugin instance, then runs two sessions of them in Adaptive quality on one "
+                     "thread, paced in real time: enough instances to keep the thread about 80% busy, and about "
+                     "10%. Each instance's own load stays a fraction of a percent in both. In the busy session "
+                     "every instance must step down to Minimum, in the quiet one none may leave Full. Exits "
+                     "non-zero otherwise.",
+                     [](const juce::ArgumentList& args) { runQuality(args); } });
+}
@@ -0,0 +1,171 @@
+/*
+  ==============================================================================
+
+    RenderCommand.cpp
+    Created: 4 Nov 2022 3:26:51pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "HostedProcessor.h"
+#include <algorithm>
+#include <iostream>
+#include <memory>
+
+namespace
+{
+    void fillNoise(juce::AudioBuffer<float>& buffer, juce::int64 seed)
+    {
+        juce::Random random (seed);
+
+        // Different noise per channel, so the dual-mono shortcut doesn't halve the work
+        for( int ch = 0; ch < buffer.getNumChannels(); ++ch )
+            for( int i = 0; i < buffer.getNumSamples(); ++i )
+                buffer.setSample(ch, i, (random.nextFloat() * 2.f - 1.f) * 0.5f);
+    }
+
+    template <typename Function>
+    double bestSeconds(int runs, Function&& function)
+    {
+        auto best = 1.0e30;
+
+        for( int run = 0; run < runs; ++run )
+        {
+            auto start = juce::Time::getHighResolutionTicks();
+            function();
+            best = std::min(best, juce::Time::highResolutionTicksToSeconds(juce::Time::getHighResolutionTicks() - start));
+        }
+
+        return best;
+    }
+
+    void runRender(const juce::ArgumentList& args)
+    {
+        auto doubleOption = [&args](const char* name, double defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getDoubleValue();
+        };
+
+        auto numCpus = juce::SystemStats::getNumCpus();
+        auto sampleRate = doubleOption("--rate", 48000);
+        auto blockSize = static_cast<int> (doubleOption("--block", 512));
+        auto seconds = doubleOption("--seconds", 20);
+        auto maxWorkers = static_cast<int> (doubleOption("--workers", juce::jmax(1, numCpus - 1)));
+
+        if (sampleRate < 8000 || blockSize < 1 || seconds <= 0 || maxWorkers < 1)
+            juce::ConsoleApplication::fail("rate must be at least 8000, block and workers at least 1 and seconds positive");
+
+        auto numSamples = static_cast<int> (seconds * sampleRate);
+
+        if (numSamples < ParallelOnePole::minimumParallelSamples)
+            juce::ConsoleApplication::fail("needs at least " + juce::String(ParallelOnePole::minimumParallelSamples) + " samples to split");
+
+        juce::AudioBuffer<float> input (2, numSamples);
+        fillNoise(input, 0x5eed);
+
+        std::cout << "render: " << seconds << " s of stereo noise at " << sampleRate << " Hz through the clean 1 kHz low-pass, "
+                  << numCpus << " CPU(s)" << std::endl;
+
+        //==============================================================================
+        // The plugin end to end: host-sized blocks against one renderOffline() call
+        auto render = [&](bool offline)
+        {
+            auto host = std::make_unique<HostedProcessor>();
+            host->setParameter("Filter Mode", 0);
+            host->setParameter("LowPass Freq", 1000);
+            host->prepare(sampleRate, blockSize);
+
+            juce::AudioBuffer<float> output;
+            output.makeCopyOf(input);
+
+            auto elapsed = bestSeconds(1, [&]
+            {
+                if (offline)
+                    host->processor.renderOffline(output, host->midi);
+                else
+                    host->process(output);
+            });
+
+            return std::make_pair(elapsed, output);
+        };
+
+        auto blocks = render(false);
+        auto offline = render(true);
+
+        auto peak = 0.f, difference = 0.f;
+
+        for( int ch = 0; ch < 2; ++ch )
+            for( int i = 0; i < numSamples; ++i )
+            {
+                peak = std::max(peak, std::abs(blocks.second.getSample(ch, i)));
+                difference = std::max(difference, std::abs(blocks.second.getSample(ch, i) - offline.second.getSample(ch, i)));
+            }
+
+        auto realtime = [seconds](double elapsed) { return juce::String(seconds / elapsed, 0) + "x realtime"; };
+
+        std::cout << "plugin, " << blockSize << "-sample blocks:  " << juce::String(blocks.first * 1000, 1) << " ms, " << realtime(blocks.first) << std::endl
+                  << "plugin, renderOffline:      " << juce::String(offline.first * 1000, 1) << " ms, " << realtime(offline.first)
+                  << ", " << juce::String(blocks.first / offline.first, 2) << "x, worst difference "
+                  << juce::String(difference / std::max(peak, 1.0e-9f), 9) << " of peak" << std::endl;
+
+        // The tolerance ParallelOnePole promises against the sequential path
+        if (difference > 1.0e-5f * peak)
+            juce::ConsoleApplication::fail("renderOffline strayed from the block render by more than 1e-5 of the peak");
+
+        //==============================================================================
+        // The split filter pass alone, against its own pool at each size. Each thread count
+        // only scales while it has a core to itself, so on a machine with fewer cores than
+        // threads the extra passes show up as a slowdown rather than a speed-up.
+        auto alpha = designOnePoleAlpha(sampleRate, 1000.f);
+        auto kernel = FilterKernelDispatch::select().process;
+        juce::AudioBuffer<float> work (2, numSamples);
+
+        auto sequential = bestSeconds(3, [&]
+        {
+            work.makeCopyOf(input);
+
+            for( int ch = 0; ch < 2; ++ch )
+                kernel(0.f, alpha, work.getReadPointer(ch), work.getWritePointer(ch), numSamples);
+        });
+
+        std::cout << std::endl << "threads   ms       speed-up  per thread" << std::endl
+                  << "seq" << juce::String(sequential * 1000, 1).paddedLeft(' ', 9) << std::endl;
+
+        for( int workers = 1; workers <= maxWorkers; ++workers )
+        {
+            WorkerPool pool (workers, false);
+
+            auto elapsed = bestSeconds(3, [&]
+            {
+                work.makeCopyOf(input);
+                float states[2] {};
+                ParallelOnePole::process(pool, work.getArrayOfWritePointers(), states, 2, alpha, numSamples, kernel);
+            });
+
+            auto threads = workers + 1;
+            auto speedUp = sequential / elapsed;
+
+            std::cout << juce::String(threads).paddedLeft(' ', 3)
+                      << juce::String(elapsed * 1000, 1).paddedLeft(' ', 9)
+                      << juce::String(speedUp, 2).paddedLeft(' ', 11)
+                      << juce::String(speedUp / threads, 2).paddedLeft(' ', 12)
+                      << (threads > numCpus ? "  (more threads than cores)" : "") << std::endl;
+        }
+    }
+}
+
+void addRenderCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "render",
+                     "render [--seconds=S] [--rate=R] [--block=B] [--workers=N]",
+                     "Times offline whole-buffer renders and how the split low-pass scales with threads",
+                     "Renders stereo noise through the plugin's clean low-pass twice: in host-sized blocks, and "
+                     "as one renderOffline() call, which splits the filter in time across the shared worker "
+                     "pool. Prints both times and their worst difference. Then times the split filter pass "
+                     "alone against a pool of 1 to N workers (default one per core but one), with the "
+                     "sequential kernel as the baseline.",
+                     [](const juce::ArgumentList& args) { runRender(args); } });
+}
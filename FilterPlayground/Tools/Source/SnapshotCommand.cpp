@@ -0,0 +1,252 @@
+/*
+  ==============================================================================
+
+    SnapshotCommand.cpp
+    Created: 4 Nov 2022 10:12:37am
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "HostedProcessor.h"
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace
+{
+    struct SnapshotCase
+    {
+        const char* name;
+        std::function<void(HostedProcessor&)> configure;
+    };
+
+    void fillNoise(juce::AudioBuffer<float>& buffer, juce::int64 seed)
+    {
+        juce::Random random (seed);
+
+        for( int ch = 0; ch < buffer.getNumChannels(); ++ch )
+            for( int i = 0; i < buffer.getNumSamples(); ++i )
+                buffer.setSample(ch, i, (random.nextFloat() * 2.f - 1.f) * 0.5f);
+    }
+
+    void runSnapshot(const juce::ArgumentList& args)
+    {
+        auto doubleOption = [&args](const char* name, double defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getDoubleValue();
+        };
+
+        auto sampleRate = doubleOption("--rate", 48000);
+        auto blockSize = static_cast<int> (doubleOption("--block", 512));
+
+        if (sampleRate < 8000 || blockSize < 1)
+            juce::ConsoleApplication::fail("rate must be at least 8000 and block at least 1");
+
+        std::vector<SnapshotCase> cases
+        {
+            { "clean", [](HostedProcessor& host)
+                {
+                    host.setParameter("Filter Mode", 0);
+                    host.setParameter("LowPass Freq", 800);
+                } },
+            { "ladder", [](HostedProcessor& host)
+                {
+                    host.setParameter("Filter Mode", 1);
+                    host.setParameter("LowPass Freq", 800);
+                    host.setParameter("Resonance", 4);
+                } },
+            { "modulated", [](HostedProcessor& host)
+                {
+                    host.setParameter("Filter Mode", 0);
+                    host.setParameter("LowPass Freq", 1200);
+                    host.setParameter("LFO Rate", 3);
+                    host.setParameter("Mod 1 Source", 1);
+                    host.setParameter("Mod 1 Target", 0);
+                    host.setParameter("Mod 1 Depth", 0.8f);
+                } },
+            { "modulated ladder", [](HostedProcessor& host)
+                {
+                    host.setParameter("Filter Mode", 1);
+                    host.setParameter("LowPass Freq", 1200);
+                    host.setParameter("Resonance", 3);
+                    host.setParameter("LFO Shape", 1);
+                    host.setParameter("LFO Rate", 5);
+                    host.setParameter("Mod 1 Source", 1);
+                    host.setParameter("Mod 1 Target", 1);
+                    host.setParameter("Mod 1 Depth", 0.5f);
+                } },
+            { "spectral", [](HostedProcessor& host)
+                {
+                    host.setParameter("Filter Mode", 2);
+                    host.setParameter("LowPass Freq", 1500);
+                    host.setParameter("Spectral Threshold", -30);
+                    host.setParameter("FFT Size", 1);
+                    host.setParameter("FFT Overlap", 2);
+                } },
+            { "modulated spectral", [](HostedProcessor& host)
+                {
+                    host.setParameter("Filter Mode", 2);
+                    host.setParameter("Spectral Mode", 1);
+                    host.setParameter("FFT Size", 4);
+                    host.setParameter("FFT Window", 2);
+                    host.setParameter("Mod 1 Source", 1);
+                    host.setParameter("Mod 1 Target", 0);
+                    host.setParameter("Mod 1 Depth", 0.6f);
+                } },
+            { "delay", [](HostedProcessor& host)
+                {
+                    host.setParameter("Filter Mode", 0);
+                    host.setParameter("Delay Type", 1);
+                    host.setParameter("Delay Interpolation", 3);
+                    host.setParameter("Delay Freq", 150);
+                    host.setParameter("Delay Gain", 0.7f);
+                } },
+            { "graph", [](HostedProcessor& host)
+                {
+                    host.setParameter("Filter Mode", 0);
+
+                    FilterGraphDescription graph;
+                    FilterGraphDescription::Node node;
+
+                    node.type = FilterModuleType::HighPass;
+                    node.frequency = 120.f;
+                    auto highPass = graph.addNode(node);
+
+                    node.type = FilterModuleType::Comb;
+                    node.frequency = 220.f;
+                    node.feedback = 0.6f;
+                    node.interpolation = DelayInterpolation::Lagrange;
+                    auto comb = graph.addNode(node);
+
+                    node.type = FilterModuleType::Allpass;
+                    node.frequency = 1300.f;
+                    node.interpolation = DelayInterpolation::Thiran;
+                    auto allpass = graph.addNode(node);
+
+                    node.type = FilterModuleType::HighShelf;
+                    node.frequency = 4000.f;
+                    node.gainDb = -6.f;
+                    auto shelf = graph.addNode(node);
+
+                    graph.connect(highPass, comb);
+                    graph.connect(highPass, allpass);
+                    graph.connect(comb, shelf);
+                    graph.connect(allpass, shelf);
+
+                    host.processor.setProcessingGraph(graph);
+                } }
+        };
+
+        // A runs long enough for the graph crossfade and the smoothers to settle, the disturbance
+        // leaves every memory holding something else before the restore
+        auto lengthA = static_cast<int> (0.5 * sampleRate);
+        auto lengthB = static_cast<int> (0.5 * sampleRate);
+        auto lengthDisturbance = static_cast<int> (0.2 * sampleRate);
+
+        std::cout << "snapshot: A+B straight through against A, capture, disturb, restore, B, and against B restored into "
+                  << "a fresh instance; "
+                  << blockSize << "-sample blocks at " << sampleRate << " Hz" << std::endl;
+
+        int failures = 0;
+
+        for( auto& snapshotCase : cases )
+        {
+            // The processor that captured, and one only prepared, as when resuming a render mid-file
+            auto reference = std::make_unique<HostedProcessor>();
+            auto restored = std::make_unique<HostedProcessor>();
+            auto fresh = std::make_unique<HostedProcessor>();
+
+            for( auto* host : { reference.get(), restored.get(), fresh.get() } )
+            {
+                snapshotCase.configure(*host);
+                host->prepare(sampleRate, blockSize);
+            }
+
+            juce::AudioBuffer<float> a (2, lengthA), expected (2, lengthB), disturbance (2, lengthDisturbance);
+            fillNoise(a, 1);
+            fillNoise(expected, 2);
+            fillNoise(disturbance, 3);
+
+            juce::AudioBuffer<float> referenceA;
+            referenceA.makeCopyOf(a);
+            reference->process(referenceA);
+
+            juce::AudioBuffer<float> b;
+            b.makeCopyOf(expected);
+            reference->process(expected);
+
+            restored->process(a);
+
+            std::vector<char> snapshot (restored->processor.getDspStateSize());
+            auto bytes = restored->processor.captureDspState(snapshot.data(), snapshot.size());
+
+            restored->process(disturbance);
+
+            for( auto* target : { restored.get(), fresh.get() } )
+            {
+                juce::AudioBuffer<float> actual;
+                actual.makeCopyOf(b);
+
+                juce::String problem;
+
+                if (bytes == 0)
+                    problem = "capture didn't fit in getDspStateSize() bytes";
+                else if (! target->processor.restoreDspState(snapshot.data(), bytes))
+                    problem = "restore rejected the snapshot";
+                else
+                {
+                    target->process(actual);
+
+                    juce::int64 mismatches = 0;
+                    juce::String first;
+
+                    for( int ch = 0; ch < 2; ++ch )
+                        for( int i = 0; i < lengthB; ++i )
+                        {
+                            auto x = expected.getSample(ch, i);
+                            auto y = actual.getSample(ch, i);
+
+                            // Bit for bit, so a NaN or a sign of zero counts too
+                            if (std::memcmp(&x, &y, sizeof(float)) != 0)
+                            {
+                                if (mismatches++ == 0)
+                                    first = "channel " + juce::String(ch) + " sample " + juce::String(i)
+                                          + ": " + juce::String(y, 9) + " instead of " + juce::String(x, 9);
+                            }
+                        }
+
+                    if (mismatches > 0)
+                        problem = juce::String(mismatches) + " of " + juce::String(2 * lengthB) + " samples differ, first " + first;
+                }
+
+                failures += problem.isEmpty() ? 0 : 1;
+
+                std::cout << (problem.isEmpty() ? "ok    " : "FAIL  ") << juce::String(snapshotCase.name).paddedRight(' ', 20)
+                          << (target == fresh.get() ? "fresh   " : "same    ")
+                          << juce::String((juce::int64) bytes).paddedLeft(' ', 9) << " bytes"
+                          << (problem.isEmpty() ? juce::String() : "  " + problem) << std::endl;
+            }
+        }
+
+        if (failures > 0)
+            juce::ConsoleApplication::fail(juce::String(failures) + " snapshot round trip(s) didn't reproduce the straight render");
+    }
+}
+
+void addSnapshotCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "snapshot",
+                     "snapshot [--rate=R] [--block=B]",
+                     "Checks that DSP snapshots reproduce an uninterrupted render bit for bit",
+                     "For each of clean, ladder and spectral, modulated or not, the delay stage and a filter graph: "
+                     "renders noise A then B straight through on one processor, and on a second renders A, "
+                     "captures its DSP state, renders something else, restores and renders B. The same "
+                     "snapshot is also restored into a third, freshly prepared processor that renders B. "
+                     "Every B render must match the straight one sample for sample. Exits non-zero on any mismatch.",
+                     [](const juce::ArgumentList& args) { runSnapshot(args); } });
+}
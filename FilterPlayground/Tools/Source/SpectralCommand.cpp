@@ -0,0 +1,111 @@
+/*
+  ==============================================================================
+
+    SpectralCommand.cpp
+    Created: 27 Oct 2022 6:40:18pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "../../Source/Engine/SpectralFilter.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace
+{
+    void runSpectral(const juce::ArgumentList& args)
+    {
+        auto doubleOption = [&args](const char* name, double defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getDoubleValue();
+        };
+
+        auto sampleRate = doubleOption("--rate", 48000);
+        auto blockSize = static_cast<int> (doubleOption("--block", 512));
+        auto seconds = doubleOption("--seconds", 0.5);
+
+        if (sampleRate < 8000 || blockSize < 1 || seconds <= 0)
+            juce::ConsoleApplication::fail("rate must be at least 8000, block at least 1 and seconds positive");
+
+        SharedDspResources resources;
+        DspArena arena;
+        arena.allocate(SpectralFilter::getArenaBytes(blockSize));
+
+        SpectralFilter filter;
+        filter.prepare(arena, resources, sampleRate, blockSize);
+
+        juce::Random random (0x5eed);
+        std::vector<float> noise ((size_t) blockSize), left ((size_t) blockSize), right ((size_t) blockSize);
+
+        for( auto& s : noise )
+            s = random.nextFloat() * 2.f - 1.f;
+
+        auto blockNanoseconds = 1.0e9 * blockSize / sampleRate;
+
+        std::cout << "spectral: stereo dynamic low-pass, " << blockSize << "-sample blocks at " << sampleRate << " Hz, "
+                  << seconds << " s per layout" << std::endl
+                  << "fft   overlap  ns/sample/ch  worst block us  worst % of block  latency ms" << std::endl;
+
+        for( int order = SpectralFilter::minOrder; order <= SpectralFilter::maxOrder; ++order )
+            for( int overlap = 2; overlap <= 8; overlap *= 2 )
+            {
+                // Taken over straight away rather than crossfaded to, starting from silence
+                filter.setLayout({ order, overlap, SpectralWindow::Hann });
+                filter.adoptPendingLayout();
+                filter.setParameters(SpectralMode::DynamicLowPass, 1000.f, -50.f);
+
+                float* channels[2] = { left.data(), right.data() };
+                juce::dsp::AudioBlock<float> block (channels, 2, (size_t) blockSize);
+
+                auto render = [&]
+                {
+                    std::copy(noise.begin(), noise.end(), left.begin());
+                    std::copy(noise.begin(), noise.end(), right.begin());
+                    filter.process(block);
+                };
+
+                // A full FFT length first, so every measured block is in steady state
+                for( int done = 0; done < SpectralFilter::getLatencySamples(order); done += blockSize )
+                    render();
+
+                juce::int64 blocks = 0, worst = 0, total = 0;
+                auto budget = juce::Time::secondsToHighResolutionTicks(seconds);
+
+                while (total < budget)
+                {
+                    auto start = juce::Time::getHighResolutionTicks();
+                    render();
+                    auto elapsed = juce::Time::getHighResolutionTicks() - start;
+
+                    worst = juce::jmax(worst, elapsed);
+                    total += elapsed;
+                    ++blocks;
+                }
+
+                auto meanNanoseconds = juce::Time::highResolutionTicksToSeconds(total) * 1.0e9 / static_cast<double> (blocks * blockSize * 2);
+                auto worstNanoseconds = juce::Time::highResolutionTicksToSeconds(worst) * 1.0e9;
+
+                std::cout << juce::String(filter.getFFTSize()).paddedRight(' ', 6)
+                          << juce::String(overlap).paddedLeft(' ', 6) << "x"
+                          << juce::String(meanNanoseconds, 1).paddedLeft(' ', 14)
+                          << juce::String(worstNanoseconds * 1.0e-3, 1).paddedLeft(' ', 16)
+                          << juce::String(100.0 * worstNanoseconds / blockNanoseconds, 2).paddedLeft(' ', 18)
+                          << juce::String(1000.0 * SpectralFilter::getLatencySamples(order) / sampleRate, 1).paddedLeft(' ', 12) << std::endl;
+            }
+    }
+}
+
+void addSpectralCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "spectral",
+                     "spectral [--rate=R] [--block=B] [--seconds=S]",
+                     "Times the STFT spectral filter for every FFT size and overlap",
+                     "Runs the stereo spectral filter over blocks of noise for each FFT size (256 to 4096) and "
+                     "overlap (2x, 4x, 8x) and prints the mean cost per sample and channel, the slowest block "
+                     "and what share of the block's duration that took, and the latency the layout reports.",
+                     [](const juce::ArgumentList& args) { runSpectral(args); } });
+}
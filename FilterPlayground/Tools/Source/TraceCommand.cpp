@@ -0,0 +1,84 @@
+/*
+  ==============================================================================
+
+    TraceCommand.cpp
+    Created: 12 Nov 2022 3:26:41pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#include "Commands.h"
+#include "HostedProcessor.h"
+#include <iostream>
+
+namespace
+{
+    void runTrace(const juce::ArgumentList& args)
+    {
+        auto doubleOption = [&args](const char* name, double defaultValue)
+        {
+            auto value = args.getValueForOption(name);
+            return value.isEmpty() ? defaultValue : value.getDoubleValue();
+        };
+
+        auto sampleRate = doubleOption("--rate", 48000);
+        auto blockSize = static_cast<int> (doubleOption("--block", 512));
+        auto seconds = doubleOption("--seconds", 0.25);
+
+        if (sampleRate < 8000 || blockSize < 1 || seconds <= 0)
+            juce::ConsoleApplication::fail("rate must be at least 8000, block at least 1 and seconds positive");
+
+        auto out = args.getValueForOption("--out");
+        auto file = juce::File::getCurrentWorkingDirectory().getChildFile(out.isEmpty() ? "FilterPlayground.trace.json" : out);
+
+        HostedProcessor host;
+        host.prepare(sampleRate, blockSize);
+
+        juce::AudioBuffer<float> buffer (2, static_cast<int> (sampleRate * seconds));
+        juce::Random random (0x5eed);
+
+        auto render = [&]
+        {
+            for( int ch = 0; ch < buffer.getNumChannels(); ++ch )
+                for( int i = 0; i < buffer.getNumSamples(); ++i )
+                    buffer.setSample(ch, i, (random.nextFloat() * 2.f - 1.f) * 0.25f);
+
+            host.process(buffer);
+        };
+
+        // The clean low-pass with its per-block coefficient update, then swept by the LFO, then the
+        // STFT, whose layout gets built on a worker
+        render();
+
+        host.setParameter("Mod 1 Source", 1);
+        host.setParameter("Mod 1 Target", 0);
+        host.setParameter("Mod 1 Depth", 0.5f);
+        render();
+
+        host.setParameter("Filter Mode", 2);
+        render();
+
+        if (! host.processor.exportTimelineTrace(file))
+            juce::ConsoleApplication::fail("nothing written to " + file.getFullPathName()
+                                           + ": build with FILTERPLAYGROUND_TRACE=1 to compile the trace markers in");
+
+        std::cout << "trace: clean, modulated and spectral, " << seconds << " s each in " << blockSize << "-sample blocks at "
+                  << sampleRate << " Hz" << std::endl
+                  << "wrote " << file.getFullPathName() << ", open it in chrome://tracing or ui.perfetto.dev" << std::endl;
+    }
+}
+
+void addTraceCommand(juce::ConsoleApplication& app)
+{
+    app.addCommand({ "trace",
+                     "trace [--out=file] [--seconds=S] [--rate=R] [--block=B]",
+                     "Records the plugin's processBlock and worker timeline and writes it as Chrome trace JSON",
+                     "Runs noise through the plugin processor in host-sized blocks: the clean low-pass, the same "
+                     "swept by the LFO, then Spectral mode, each for --seconds. Then writes every stage and worker "
+                     "job still in the trace rings to --out (FilterPlayground.trace.json by default), for "
+                     "chrome://tracing or ui.perfetto.dev. The rings keep the last 4096 events per thread, so a "
+                     "long run only shows its end. Only a build with FILTERPLAYGROUND_TRACE=1 records anything; "
+                     "otherwise it fails without writing.",
+                     [](const juce::ArgumentList& args) { runTrace(args); } });
+}
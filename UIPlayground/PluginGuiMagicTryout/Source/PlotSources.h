@@ -0,0 +1,426 @@
+/*
+  ==============================================================================
+
+    PlotSources.h
+    Created: 24 Oct 2022 7:48:03pm
+    Author:  Natalia Escalera
+
+  ==============================================================================
+*/
+
+#pragma once
+#include <JuceHeader.h>
+#include <array>
+#include <atomic>
+#include <complex>
+#include <memory>
+#include <vector>
+#include "../../../FilterPlayground/Source/Engine/LadderFilter.h"
+#include "../../../FilterPlayground/Source/Engine/SharedResources.h"
+
+// Hands the most recent frame from the audio thread to the GUI: the audio thread fills its back
+// buffer and swaps it with the middle one, the GUI swaps the middle one out when it's marked
+// fresh. Neither side waits, and a frame the GUI never got to is simply overwritten.
+class FrameExchange
+{
+public:
+    // Not on the audio thread, and not while the GUI is reading
+    void prepare(int newFrameSize)
+    {
+        frameSize = newFrameSize;
+
+        for( auto& buffer : buffers )
+            buffer.assign((size_t) frameSize, 0.f);
+
+        writeIndex = 0;
+        readIndex = 1;
+        middle.store(2);
+    }
+
+    int getFrameSize() const noexcept { return frameSize; }
+
+    // Audio thread
+    float* getWriteBuffer() noexcept { return buffers[(size_t) writeIndex].data(); }
+
+    void publish() noexcept
+    {
+        writeIndex = middle.exchange(writeIndex | freshFlag, std::memory_order_acq_rel) & indexMask;
+    }
+
+    // GUI thread, true if there was a new frame
+    bool fetch() noexcept
+    {
+        if ((middle.load(std::memory_order_relaxed) & freshFlag) == 0)
+            return false;
+
+        readIndex = middle.exchange(readIndex, std::memory_order_acq_rel) & indexMask;
+        return true;
+    }
+
+    const float* getReadBuffer() const noexcept { return buffers[(size_t) readIndex].data(); }
+
+private:
+    static constexpr int freshFlag = 4, indexMask = 3;
+
+    std::array<std::vector<float>, 3> buffers;
+    int frameSize {0};
+    int writeIndex {0}, readIndex {1};
+    std::atomic<int> middle {2};
+};
+
+// Base for the analyser and the oscilloscope. The audio thread mixes every block down to mono
+// into a history ring and, at most maxRefreshHz times a second, publishes the latest frame and
+// bumps the data timestamp the plot components poll. Once the input has been silent for a whole
+// frame the display is cleared with one last frame and nothing is published until sound comes
+// back, so an idle plugin costs the GUI no repaints at all.
+//
+// pushSamples() never locks or allocates, everything is sized in prepareToPlay().
+class ThrottledPlotSource : public foleys::MagicPlotSource
+{
+public:
+    static constexpr float silenceThreshold = 3.16e-5f;    // -90 dBFS
+
+    void setMaxRefreshRate(double hz) noexcept { maxRefreshHz = hz; }
+
+    void prepareToPlay(double newSampleRate, int) override
+    {
+        sampleRate = newSampleRate;
+        publishInterval = juce::jmax(1, static_cast<int> (sampleRate / maxRefreshHz));
+
+        auto frameSize = getFrameSize(sampleRate);
+        history.assign((size_t) frameSize, 0.f);
+        exchange.prepare(frameSize);
+
+        writePosition = 0;
+        samplesSincePublish = 0;
+        samplesSinceSound = frameSize + publishInterval;
+        prepared();
+    }
+
+    void pushSamples(const juce::AudioBuffer<float>& buffer) override
+    {
+        auto frameSize = static_cast<int> (history.size());
+        auto numChannels = juce::jmin(2, buffer.getNumChannels());
+        auto numSamples = buffer.getNumSamples();
+
+        if (frameSize == 0 || numChannels == 0 || numSamples == 0)
+            return;
+
+        // Only the last frame's worth of a long block can end up on screen
+        auto offset = juce::jmax(0, numSamples - frameSize);
+        auto gain = 1.f / static_cast<float> (numChannels);
+        auto peak = 0.f;
+
+        for( int done = offset; done < numSamples; )
+        {
+            auto n = juce::jmin(numSamples - done, frameSize - writePosition);
+            auto* dest = history.data() + writePosition;
+
+            for( int ch = 0; ch < numChannels; ++ch )
+            {
+                if (ch == 0)
+                    juce::FloatVectorOperations::copyWithMultiply(dest, buffer.getReadPointer(ch, done), gain, n);
+                else
+                    juce::FloatVectorOperations::addWithMultiply(dest, buffer.getReadPointer(ch, done), gain, n);
+            }
+
+            auto range = juce::FloatVectorOperations::findMinAndMax(dest, n);
+            peak = juce::jmax(peak, -range.getStart(), range.getEnd());
+
+            writePosition = (writePosition + n) % frameSize;
+            done += n;
+        }
+
+        samplesSinceSound = peak >= silenceThreshold ? 0 : juce::jmin(samplesSinceSound + numSamples, 2 * frameSize + publishInterval);
+        samplesSincePublish += numSamples;
+
+        if (samplesSincePublish < publishInterval)
+            return;
+
+        samplesSincePublish = 0;
+
+        // Publish while any sound is still inside the frame, plus the first all-silent frame
+        if (samplesSinceSound > frameSize + publishInterval)
+            return;
+
+        auto* frame = exchange.getWriteBuffer();
+        std::copy(history.begin() + writePosition, history.end(), frame);
+        std::copy(history.begin(), history.begin() + writePosition, frame + (frameSize - writePosition));
+
+        exchange.publish();
+        resetLastDataUpdate();
+    }
+
+protected:
+    virtual int getFrameSize(double rate) const = 0;
+    virtual void prepared() {}
+
+    double sampleRate {48000};
+    FrameExchange exchange;
+
+private:
+    double maxRefreshHz {30};
+    int publishInterval {1600};
+
+    std::vector<float> history;
+    int writePosition {0};
+    int samplesSincePublish {0};
+    int samplesSinceSound {0};
+};
+
+// Magnitude spectrum on a log frequency axis. The FFT runs on the GUI thread, once per published
+// frame however many editors are showing it. The window comes from SharedDspResources, the FFT is
+// this source's own since JUCE's fallback engine locks inside perform.
+class SpectrumPlotSource : public ThrottledPlotSource
+{
+public:
+    static constexpr int fftOrder = 11;
+    static constexpr int fftSize = 1 << fftOrder;
+    static constexpr float minDb = -90.f;
+
+    void createPlotPaths(juce::Path& path, juce::Path& filledPath, juce::Rectangle<float> bounds, foleys::MagicPlotComponent&) override
+    {
+        if (exchange.fetch())
+            analyse();
+
+        path.clear();
+        filledPath.clear();
+
+        if (fft == nullptr || bounds.getWidth() < 2)
+            return;
+
+        auto columns = static_cast<int> (bounds.getWidth());
+        auto nyquist = juce::jmin(20000.0, sampleRate * 0.5);
+
+        for( int x = 0; x <= columns; ++x )
+        {
+            // 20 Hz to 20 kHz (or Nyquist), linearly interpolated between bins
+            auto frequency = 20.0 * std::pow(nyquist / 20.0, x / static_cast<double> (columns));
+            auto position = juce::jlimit(0.0, fftSize / 2 - 1.0, frequency * fftSize / sampleRate);
+            auto bin = static_cast<int> (position);
+            auto frac = static_cast<float> (position - bin);
+            auto db = decibels[(size_t) bin] + frac * (decibels[(size_t) bin + 1] - decibels[(size_t) bin]);
+
+            auto px = bounds.getX() + static_cast<float> (x);
+            auto py = juce::jmap(db, minDb, 0.f, bounds.getBottom(), bounds.getY());
+
+            if (x == 0)
+                path.startNewSubPath(px, py);
+            else
+                path.lineTo(px, py);
+        }
+
+        filledPath = path;
+        filledPath.lineTo(bounds.getBottomRight());
+        filledPath.lineTo(bounds.getBottomLeft());
+        filledPath.closeSubPath();
+    }
+
+protected:
+    int getFrameSize(double) const override { return fftSize; }
+
+    void prepared() override
+    {
+        if (fft == nullptr)
+            fft = std::make_unique<juce::dsp::FFT>(fftOrder);
+
+        window = resources->getWindow(fftSize, SharedDspResources::WindowType::hann);
+
+        fftData.assign(2 * (size_t) fftSize, 0.f);
+        decibels.assign((size_t) fftSize / 2 + 1, minDb);
+
+        // Full-scale sine reads 0 dB whatever the window
+        double sum = 0;
+        for( auto w : *window )
+            sum += w;
+
+        normalisation = static_cast<float> (2.0 / sum);
+    }
+
+private:
+    void analyse()
+    {
+        if (fft == nullptr)
+            return;
+
+        juce::FloatVectorOperations::multiply(fftData.data(), exchange.getReadBuffer(), window->data(), fftSize);
+        std::fill(fftData.begin() + fftSize, fftData.end(), 0.f);
+
+        fft->performFrequencyOnlyForwardTransform(fftData.data());
+
+        for( size_t bin = 0; bin < decibels.size(); ++bin )
+            decibels[bin] = juce::Decibels::gainToDecibels(fftData[bin] * normalisation, minDb);
+    }
+
+    juce::SharedResourcePointer<SharedDspResources> resources;
+    std::unique_ptr<juce::dsp::FFT> fft;
+    std::shared_ptr<const std::vector<float>> window;
+
+    std::vector<float> fftData, decibels;
+    float normalisation {1};
+};
+
+// Waveform, triggered on a rising zero crossing so a steady tone stands still. The frame holds
+// two display lengths, the trigger is looked for in the first one.
+class WaveformPlotSource : public ThrottledPlotSource
+{
+public:
+    void createPlotPaths(juce::Path& path, juce::Path& filledPath, juce::Rectangle<float> bounds, foleys::MagicPlotComponent&) override
+    {
+        if (exchange.fetch())
+            findTrigger();
+
+        path.clear();
+        filledPath.clear();
+
+        auto frameSize = exchange.getFrameSize();
+        auto length = frameSize / 2;
+
+        if (length == 0 || bounds.getWidth() < 2)
+            return;
+
+        auto* samples = exchange.getReadBuffer() + trigger;
+        auto step = juce::jmax(1, static_cast<int> (length / bounds.getWidth()));
+
+        for( int i = 0; i < length; i += step )
+        {
+            auto px = bounds.getX() + bounds.getWidth() * static_cast<float> (i) / static_cast<float> (length);
+            auto py = juce::jmap(juce::jlimit(-1.f, 1.f, samples[i]), -1.f, 1.f, bounds.getBottom(), bounds.getY());
+
+            if (i == 0)
+                path.startNewSubPath(px, py);
+            else
+                path.lineTo(px, py);
+        }
+    }
+
+protected:
+    // About 20 ms shown
+    int getFrameSize(double rate) const override { return 2 * juce::nextPowerOfTwo(static_cast<int> (rate * 0.02)); }
+
+    void prepared() override { trigger = 0; }
+
+private:
+    void findTrigger()
+    {
+        auto* samples = exchange.getReadBuffer();
+        auto length = exchange.getFrameSize() / 2;
+
+        trigger = 0;
+
+        for( int i = 1; i < length; ++i )
+            if (samples[i - 1] <= 0 && samples[i] > 0)
+            {
+                trigger = i;
+                break;
+            }
+    }
+
+    int trigger {0};
+};
+
+// The filter's analytic magnitude response for the current settings. The audio thread only
+// reports the settings when they change, so the curve is redrawn on parameter moves and never
+// otherwise.
+class FilterResponsePlotSource : public foleys::MagicPlotSource
+{
+public:
+    static constexpr float minDb = -48.f, maxDb = 24.f;
+
+    void prepareToPlay(double newSampleRate, int) override
+    {
+        sampleRate.store(newSampleRate);
+        resetLastDataUpdate();
+    }
+
+    void pushSamples(const juce::AudioBuffer<float>&) override {}
+
+    // Audio thread
+    void setParameters(float alpha, float cutoff, float resonanceAmount, bool ladder) noexcept
+    {
+        if (alpha == lastAlpha && cutoff == lastCutoff && resonanceAmount == lastResonance && ladder == lastLadder)
+            return;
+
+        lastAlpha = alpha;
+        lastCutoff = cutoff;
+        lastResonance = resonanceAmount;
+        lastLadder = ladder;
+
+        settings.alpha.store(alpha, std::memory_order_relaxed);
+        settings.cutoff.store(cutoff, std::memory_order_relaxed);
+        settings.resonance.store(resonanceAmount, std::memory_order_relaxed);
+        settings.ladder.store(ladder, std::memory_order_relaxed);
+        resetLastDataUpdate();
+    }
+
+    void createPlotPaths(juce::Path& path, juce::Path& filledPath, juce::Rectangle<float> bounds, foleys::MagicPlotComponent&) override
+    {
+        path.clear();
+        filledPath.clear();
+
+        auto rate = sampleRate.load();
+        auto columns = static_cast<int> (bounds.getWidth());
+
+        if (columns < 2)
+            return;
+
+        auto alpha = static_cast<double> (settings.alpha.load(std::memory_order_relaxed));
+        auto ladder = settings.ladder.load(std::memory_order_relaxed);
+
+        // Same stage and loop gain as LadderFilter::setParameters
+        auto fc = juce::jlimit(20.0, 0.49 * rate, static_cast<double> (settings.cutoff.load(std::memory_order_relaxed)));
+        auto g = std::tan(juce::MathConstants<double>::pi * fc / rate);
+        auto G = g / (1.0 + g);
+        auto k = LadderFilter::maxFeedback * settings.resonance.load(std::memory_order_relaxed);
+        auto nyquist = juce::jmin(20000.0, rate * 0.5);
+
+        for( int x = 0; x <= columns; ++x )
+        {
+            auto frequency = 20.0 * std::pow(nyquist / 20.0, x / static_cast<double> (columns));
+            auto z1 = std::polar(1.0, -2.0 * juce::MathConstants<double>::pi * frequency / rate);
+
+            std::complex<double> h;
+
+            if (ladder)
+            {
+                auto h1 = G * (1.0 + z1) / (1.0 + (2.0 * G - 1.0) * z1);
+                auto h4 = h1 * h1 * h1 * h1;
+                h = (1.0 + k) * h4 / (1.0 + k * h4);
+            }
+            else
+            {
+                h = alpha * (1.0 + z1) / (1.0 + (2.0 * alpha - 1.0) * z1);
+            }
+
+            auto db = juce::jlimit(minDb, maxDb, juce::Decibels::gainToDecibels(static_cast<float> (std::abs(h)), minDb));
+            auto px = bounds.getX() + static_cast<float> (x);
+            auto py = juce::jmap(db, minDb, maxDb, bounds.getBottom(), bounds.getY());
+
+            if (x == 0)
+                path.startNewSubPath(px, py);
+            else
+                path.lineTo(px, py);
+        }
+
+        filledPath = path;
+        filledPath.lineTo(bounds.getBottomRight());
+        filledPath.lineTo(bounds.getBottomLeft());
+        filledPath.closeSubPath();
+    }
+
+private:
+    struct Settings
+    {
+        std::atomic<float> alpha {1.f};
+        std::atomic<float> cutoff {1000.f};
+        std::atomic<float> resonance {0.f};
+        std::atomic<bool> ladder {false};
+    };
+
+    Settings settings;
+    std::atomic<double> sampleRate {48000};
+
+    // Audio thread's copy, to spot changes without touching the atomics
+    float lastAlpha {-1}, lastCutoff {-1}, lastResonance {-1};
+    bool lastLadder {false};
+};
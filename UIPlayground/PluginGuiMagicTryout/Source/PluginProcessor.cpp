@@ -22,12 +22,34 @@ PluginGuiMagicTryoutAudioProcessor::PluginGuiMagicTryoutAudioProcessor()
     apvts(*this, nullptr, "Parameters", createParameterLayout())
 #endif
 {
+    cutoffParameter = apvts.getRawParameterValue("LowPass Freq");
+    resonanceParameter = apvts.getRawParameterValue("Resonance");
+    filterModeParameter = apvts.getRawParameterValue("Filter Mode");
+
+    inputAnalyser = magicState.createAndAddObject<SpectrumPlotSource>("input");
+    outputAnalyser = magicState.createAndAddObject<SpectrumPlotSource>("output");
+    oscilloscope = magicState.createAndAddObject<WaveformPlotSource>("waveform");
+    filterResponse = magicState.createAndAddObject<FilterResponsePlotSource>("response");
+
+    for( auto* source : { static_cast<ThrottledPlotSource*> (inputAnalyser), static_cast<ThrottledPlotSource*> (outputAnalyser), static_cast<ThrottledPlotSource*> (oscilloscope) } )
+        source->setMaxRefreshRate(maxPlotRefreshHz);
 }
 
 juce::AudioProcessorValueTreeState::ParameterLayout PluginGuiMagicTryoutAudioProcessor::createParameterLayout() {
     juce::AudioProcessorValueTreeState::ParameterLayout layout;
 
-    layout.add(std::make_unique<juce::AudioParameterBool>("dummyBool", "dummyBool", true));
+    // Same IDs and ranges as FilterPlayground, so presets and automation carry over
+    layout.add(std::make_unique<juce::AudioParameterFloat>("LowPass Freq",
+                                                           "LowPass Freq",
+                                                           juce::NormalisableRange<float>(20.f, 20000.f, 1.f, 0.25f),
+                                                           1000.f));
+
+    layout.add(std::make_unique<juce::AudioParameterFloat>("Resonance",
+                                                           "Resonance",
+                                                           juce::NormalisableRange<float>(0.1f, 10.f, 0.05f, 1.f),
+                                                           0.f));
+
+    layout.add(std::make_unique<juce::AudioParameterChoice>("Filter Mode", "Filter Mode", juce::StringArray { "Clean", "Ladder" }, 0));
     return layout;
 }
 
@@ -100,8 +122,51 @@ void PluginGuiMagicTryoutAudioProcessor::changeProgramName (int index, const juc
 //==============================================================================
 void PluginGuiMagicTryoutAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
-    // Use this method as the place to do any pre-playback
-    // initialisation that you need..
+    cFilter.prepare(*sharedResources, sampleRate);
+
+    juce::dsp::ProcessSpec spec { sampleRate, static_cast<juce::uint32> (samplesPerBlock), 1 };
+    auto& kernels = FilterKernelDispatch::select();
+
+    for( auto& filter : lowPass )
+    {
+        filter.prepare(spec);
+        filter.setKernels(kernels.process, kernels.processRamp);
+        filter.setAlpha(cFilter.getAlpha(sampleRate, cutoffParameter->load()));
+    }
+
+    for( auto& ladder : ladders )
+        ladder.prepare(sampleRate);
+
+    // Sizes the plot sources' history and frames
+    magicState.prepareToPlay(sampleRate, samplesPerBlock);
+}
+
+void PluginGuiMagicTryoutAudioProcessor::updateFilters()
+{
+    auto cutoff = cutoffParameter->load();
+    auto resonance = LadderFilter::getResonanceAmount(resonanceParameter->load());
+    auto ladder = filterModeParameter->load() > 0.5f;
+    auto alpha = cFilter.getAlpha(getSampleRate(), cutoff);
+
+    if (ladder != ladderActive)
+    {
+        for( auto& filter : lowPass )
+            filter.reset();
+
+        for( auto& l : ladders )
+            l.reset();
+
+        ladderActive = ladder;
+    }
+
+    // The one-pole ramps to the new alpha over the block
+    for( auto& filter : lowPass )
+        filter.setTargetAlpha(alpha);
+
+    for( auto& l : ladders )
+        l.setParameters(cutoff, resonance);
+
+    filterResponse->setParameters(alpha, cutoff, resonance, ladder);
 }
 
 void PluginGuiMagicTryoutAudioProcessor::releaseResources()
@@ -151,18 +216,30 @@ void PluginGuiMagicTryoutAudioProcessor::processBlock (juce::AudioBuffer<float>&
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, buffer.getNumSamples());
 
-    // This is the place where you'd normally do the guts of your plugin's
-    // audio processing...
-    // Make sure to reset the state if your inner loop is processing
-    // the samples and the outer loop is handling the channels.
-    // Alternatively, you can process the samples with the channels
-    // interleaved by keeping the same state.
-    for (int channel = 0; channel < totalNumInputChannels; ++channel)
-    {
-        auto* channelData = buffer.getWritePointer (channel);
+    inputAnalyser->pushSamples(buffer);
+
+    updateFilters();
 
-        // ..do something to the data...
+    auto numSamples = buffer.getNumSamples();
+    auto numChannels = juce::jmin(totalNumInputChannels, static_cast<int> (lowPass.size()));
+
+    for( int ch = 0; ch < numChannels; ++ch )
+    {
+        auto* channelData = buffer.getWritePointer(ch);
+
+        if (ladderActive)
+        {
+            ladders[(size_t) ch].process(channelData, channelData, numSamples);
+        }
+        else
+        {
+            juce::dsp::AudioBlock<float> block (&channelData, 1, (size_t) numSamples);
+            lowPass[(size_t) ch].process(juce::dsp::ProcessContextReplacing<float>(block));
+        }
     }
+
+    outputAnalyser->pushSamples(buffer);
+    oscilloscope->pushSamples(buffer);
 }
 
 
@@ -9,6 +9,11 @@
 #pragma once
 
 #include <JuceHeader.h>
+#include <array>
+#include "PlotSources.h"
+#include "../../../FilterPlayground/Source/Engine/CustomFilter.h"
+#include "../../../FilterPlayground/Source/Engine/FilterKernels.h"
+#include "../../../FilterPlayground/Source/Engine/LadderFilter.h"
 
 //==============================================================================
 /**
@@ -50,7 +55,29 @@ public:
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
     juce::AudioProcessorValueTreeState apvts{ *this, nullptr, "Parameters", createParameterLayout() };
 
+    // Plots don't get new data more often than this, and not at all while the input is silent
+    static constexpr double maxPlotRefreshHz = 30.0;
+
 private:
+    // FilterPlayground's filter section: the clean one-pole on the dispatched kernels, or the ladder
+    void updateFilters();
+
+    juce::SharedResourcePointer<SharedDspResources> sharedResources;
+    CustomFilter cFilter;
+    std::array<OnePoleLowPass, 2> lowPass;
+    std::array<LadderFilter, 2> ladders;
+    bool ladderActive {false};
+
+    std::atomic<float>* cutoffParameter {nullptr};
+    std::atomic<float>* resonanceParameter {nullptr};
+    std::atomic<float>* filterModeParameter {nullptr};
+
+    // Owned by magicState
+    SpectrumPlotSource* inputAnalyser {nullptr};
+    SpectrumPlotSource* outputAnalyser {nullptr};
+    WaveformPlotSource* oscilloscope {nullptr};
+    FilterResponsePlotSource* filterResponse {nullptr};
+
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginGuiMagicTryoutAudioProcessor)
 };